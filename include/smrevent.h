@@ -0,0 +1,119 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SMREVENT_H
+#define SMREVENT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <time.h>
+
+#include <smrproxy.h>
+
+/**
+ * @brief opaque handle to a multi-consumer broadcast event queue
+ *
+ * Every listener sees every event published after it started listening.
+ * Producers append without locking, listeners advance through the queue
+ * with smrproxy_ref_next so published events are reclaimed once the
+ * slowest listener has moved past them.
+*/
+typedef struct smrevent_t smrevent_t;
+
+/**
+ * @brief opaque handle to an event queue listener
+*/
+typedef struct smrevent_listener_t smrevent_listener_t;
+
+/**
+ * Create a broadcast event queue
+ *
+ * @param proxy smrproxy used to reclaim consumed events
+ * @param dtor destructor for published events or NULL
+ * @returns the event queue or NULL
+*/
+extern smrevent_t * smrevent_create(smrproxy_t *proxy, void (*dtor)(void *));
+
+/**
+ * Destroy a broadcast event queue
+ *
+ * @param queue the event queue
+ *
+ * @note all listeners must have been removed.  Events still in the queue
+ * are retired.
+*/
+extern void smrevent_destroy(smrevent_t *queue);
+
+/**
+ * Publish an event to all current listeners.
+ *
+ * @param queue the event queue
+ * @param event the event
+ * @returns thrd_success or thrd_nomem
+*/
+extern int smrevent_publish(smrevent_t *queue, void *event);
+
+/**
+ * Start listening on an event queue.
+ * The listener sees events published after this call.
+ *
+ * @param queue the event queue
+ * @returns the listener or NULL
+ *
+ * @note the listener uses the calling thread's smrproxy reference, so
+ * a thread may have only one listener per proxy and must not otherwise
+ * acquire or release that reference while listening.
+*/
+extern smrevent_listener_t * smrevent_listen(smrevent_t *queue);
+
+/**
+ * Stop listening.
+ *
+ * @param listener the listener
+*/
+extern void smrevent_unlisten(smrevent_listener_t *listener);
+
+/**
+ * Read a batch of events.
+ *
+ * @param listener the listener
+ * @param events array to store events into
+ * @param count size of events array
+ * @returns number of events read, 0 if none available
+ *
+ * @note events are valid until the next call to smrevent_read or
+ * smrevent_unlisten.
+*/
+extern size_t smrevent_read(smrevent_listener_t *listener, void **events, size_t count);
+
+/**
+ * Wait until events are available to read.
+ *
+ * @param listener the listener
+ * @param abstime absolute TIME_UTC based timeout, or NULL to wait indefinitely
+ * @returns thrd_success, thrd_timedout, or thrd_error
+*/
+extern int smrevent_wait(smrevent_listener_t *listener, const struct timespec *abstime);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SMREVENT_H */
@@ -0,0 +1,153 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SMRLF_H
+#define SMRLF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <smrproxy.h>
+
+/**
+ * Lock-free multi-producer multi-consumer containers
+ *
+ * A Michael-Scott queue and a Treiber stack of void * values.  Nodes
+ * removed from a container are retired to an smrproxy, and operations
+ * which dereference nodes run inside a read section, so a node can't be
+ * freed and reused while another thread may still compare against it.
+ * That makes plain single-width compare and swap ABA safe without tagged
+ * pointers.  Nodes removed together in one operation are retired as a
+ * single retire queue entry.  If the retire queue is full, removed nodes
+ * are kept on a pending list and retired by a later removal.
+*/
+
+/**
+ * @brief opaque handle to a lock-free FIFO queue
+*/
+typedef struct smrmsq_t smrmsq_t;
+
+/**
+ * @brief opaque handle to a lock-free LIFO stack
+*/
+typedef struct smrstack_t smrstack_t;
+
+/**
+ * Create a queue
+ *
+ * @param proxy smrproxy used to reclaim removed nodes
+ * @param dtor destructor for values still queued when the queue is destroyed, or NULL
+ * @returns the queue or NULL
+*/
+extern smrmsq_t * smrmsq_create(smrproxy_t *proxy, void (*dtor)(void *));
+
+/**
+ * Destroy a queue
+ *
+ * @param queue the queue
+ *
+ * @note there must be no other threads using the queue.
+*/
+extern void smrmsq_destroy(smrmsq_t *queue);
+
+/**
+ * Append a value.
+ * Must be called inside a read section.
+ *
+ * @param queue the queue
+ * @param value the value
+ * @returns true or false if no memory
+*/
+extern bool smrmsq_enqueue(smrmsq_t *queue, void *value);
+
+/**
+ * Remove the oldest value.
+ * Must be called inside a read section.
+ *
+ * @param queue the queue
+ * @param pvalue set to removed value
+ * @returns true or false if queue empty
+*/
+extern bool smrmsq_dequeue(smrmsq_t *queue, void **pvalue);
+
+/**
+ * Remove up to count oldest values with a single compare and swap.
+ * Must be called inside a read section.
+ *
+ * @param queue the queue
+ * @param values removed values, oldest first
+ * @param count maximum number of values to remove
+ * @returns number of values removed
+*/
+extern unsigned int smrmsq_dequeue_batch(smrmsq_t *queue, void **values, unsigned int count);
+
+/**
+ * Create a stack
+ *
+ * @param proxy smrproxy used to reclaim removed nodes
+ * @param dtor destructor for values still on the stack when it is destroyed, or NULL
+ * @returns the stack or NULL
+*/
+extern smrstack_t * smrstack_create(smrproxy_t *proxy, void (*dtor)(void *));
+
+/**
+ * Destroy a stack
+ *
+ * @param stack the stack
+ *
+ * @note there must be no other threads using the stack.
+*/
+extern void smrstack_destroy(smrstack_t *stack);
+
+/**
+ * Push a value.  Need not be called inside a read section.
+ *
+ * @param stack the stack
+ * @param value the value
+ * @returns true or false if no memory
+*/
+extern bool smrstack_push(smrstack_t *stack, void *value);
+
+/**
+ * Pop the most recently pushed value.
+ * Must be called inside a read section.
+ *
+ * @param stack the stack
+ * @param pvalue set to popped value
+ * @returns true or false if stack empty
+*/
+extern bool smrstack_pop(smrstack_t *stack, void **pvalue);
+
+/**
+ * Pop up to count values with a single compare and swap.
+ * Must be called inside a read section.
+ *
+ * @param stack the stack
+ * @param values popped values, most recently pushed first
+ * @param count maximum number of values to pop
+ * @returns number of values popped
+*/
+extern unsigned int smrstack_pop_batch(smrstack_t *stack, void **values, unsigned int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SMRLF_H */
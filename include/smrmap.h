@@ -0,0 +1,118 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SMRMAP_H
+#define SMRMAP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <smrproxy.h>
+
+/**
+ * @brief opaque handle to an ordered map
+ *
+ * Skiplist keyed by uint64_t.  Readers traverse without locks inside an
+ * smrproxy read section.  Writers are serialized and retire replaced or
+ * removed nodes in batches.
+*/
+typedef struct smrmap_t smrmap_t;
+
+/**
+ * Create an ordered map
+ *
+ * @param proxy smrproxy used to reclaim removed nodes
+ * @param dtor destructor for values or NULL
+ * @param batch number of removed nodes retired together, or 0 for default
+ * @returns the map or NULL
+*/
+extern smrmap_t * smrmap_create(smrproxy_t *proxy, void (*dtor)(void *), unsigned int batch);
+
+/**
+ * Destroy an ordered map
+ *
+ * @param map the map
+ *
+ * @note there must be no readers or writers.  All nodes are retired.
+*/
+extern void smrmap_destroy(smrmap_t *map);
+
+/**
+ * Insert or replace a value.
+ *
+ * @param map the map
+ * @param key the key
+ * @param value the value
+ * @returns thrd_success or thrd_nomem
+*/
+extern int smrmap_put(smrmap_t *map, uint64_t key, void *value);
+
+/**
+ * Remove a value.
+ *
+ * @param map the map
+ * @param key the key
+ * @returns true if key was removed
+*/
+extern bool smrmap_remove(smrmap_t *map, uint64_t key);
+
+/**
+ * Retire any removed nodes not yet retired.
+ *
+ * @param map the map
+ * @returns true if nothing is left pending, false if the retire queue was full
+*/
+extern bool smrmap_flush(smrmap_t *map);
+
+/**
+ * Look up a value.
+ * Must be called inside a read section, i.e. between smrproxy_ref_acquire
+ * and smrproxy_ref_release.
+ *
+ * @param map the map
+ * @param key the key
+ * @returns the value or NULL if not found
+*/
+extern void * smrmap_get(smrmap_t *map, uint64_t key);
+
+/**
+ * Scan key range [lo, hi] in key order.
+ * Must be called inside a read section.  The ref is advanced with
+ * smrproxy_ref_next as the scan proceeds so a long scan does not hold
+ * back reclamation of nodes it has already passed.  A value passed to fn
+ * is only valid until fn returns.
+ *
+ * @param map the map
+ * @param ref the calling thread's acquired reference
+ * @param lo lowest key
+ * @param hi highest key
+ * @param fn function called for each key, returns false to stop the scan
+ * @param ctx context for fn or NULL
+ * @returns number of keys visited
+*/
+extern size_t smrmap_scan(smrmap_t *map, smrproxy_ref_t *ref, uint64_t lo, uint64_t hi, bool (*fn)(uint64_t key, void *value, void *ctx), void *ctx);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SMRMAP_H */
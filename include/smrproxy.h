@@ -24,9 +24,45 @@ extern "C" {
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
+#ifdef SMRPROXY_CLOCK
+#include <time.h>
+#endif
 
 typedef uint32_t epoch_t;
 
+#ifdef SMRPROXY_CLOCK
+/**
+ * Clock based epochs, experimental.
+ *
+ * Built with SMRPROXY_CLOCK defined, for the library and applications
+ * alike, epochs are taken from CLOCK_MONOTONIC_COARSE rather than a shared
+ * counter advanced by every retire.  Readers stamp their ref from the
+ * clock and retired objects are tagged with the clock at retire time, so
+ * there is no write hot epoch cache line and the poll thread doesn't
+ * write an epoch into every ref.  Reclamation waits for the clock to tick
+ * past an object's expiry, a few milliseconds at most.
+ *
+ * Epochs are clock nanoseconds shifted right by SMRPROXY_CLOCK_SHIFT, made
+ * odd.  They wrap after about 78 hours, a reader can't stay in a read
+ * section for more than about 39 hours.  smrshm proxies keep counter
+ * epochs, their readers must use smrshm_ref_acquire rather than
+ * smrproxy_ref_acquire.
+*/
+#define SMRPROXY_CLOCK_SHIFT 16
+
+/**
+ * Get the current clock epoch.
+ * @returns clock epoch, odd
+*/
+inline static epoch_t smrproxy_clock_epoch()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    uint64_t nanos = (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+    return (epoch_t) (nanos >> SMRPROXY_CLOCK_SHIFT) | 1;
+}
+#endif
+
 /**
  * local quiescent state count
 */
@@ -47,6 +83,41 @@ typedef struct smrproxy_config_t {
     long cachesize;                 // default cachesize if not available from system, must be a power of 2.
 } smrproxy_config_t;
 
+/**
+ * maximum number of registered batch dtors per proxy
+*/
+#define SMRPROXY_MAX_BATCH 8
+
+/**
+ * number of retire to reclaim latency histogram buckets
+*/
+#define SMRPROXY_HIST_SIZE 40
+
+/*
+* smrproxy statistics
+*/
+typedef struct smrproxy_stats_t {
+    unsigned long retired;          // objects retired
+    unsigned long reclaimed;        // objects reclaimed, i.e. dtor called
+    unsigned int queue_depth;       // objects retired but not yet reclaimed
+    unsigned int held;              // reclaimable objects held back by hazard pointers
+    epoch_t epoch_lag;              // current epoch minus oldest unreclaimed epoch
+
+    unsigned long membar_count;     // global memory barriers executed
+    uint64_t membar_time;           // total global memory barrier time in nanoseconds
+
+    unsigned long scan_count;       // scans of proxy refs
+    uint64_t scan_time;             // total ref scan time in nanoseconds
+    uint64_t scan_time_max;         // longest ref scan time in nanoseconds
+
+    /*
+    * retire to reclaim latency, bucket n counts latencies
+    * in nanoseconds in range [2**n, 2**(n+1)), last bucket
+    * counts all longer latencies.
+    */
+    unsigned long latency[SMRPROXY_HIST_SIZE];
+} smrproxy_stats_t;
+
 /*
 * reader reference to epoch
 */
@@ -54,13 +125,14 @@ typedef struct smrproxy_ref_t {
     epoch_t epoch;                  // epoch as observed by reader thread, or 0
     epoch_t *proxy_epoch;
 
+    epoch_t upper;                  // reservation upper bound, IBR readers only, 0 if unbounded
 
-    /*-*/
+    void *hazard;                   // object held by hazard pointer or NULL
 
-    epoch_t current_epoch;          // current epoch set by reclaim thread
 
+    /*-*/
 
-    epoch_t effective_epoch;         // effective epoch as observed by reclaim thread, never 0
+    epoch_t current_epoch;          // current epoch set by reclaim thread, only written when it changes
 
 
     //
@@ -97,6 +169,23 @@ extern smrproxy_t * smrproxy_create(smrproxy_config_t *config);
 */
 extern void smrproxy_destroy(smrproxy_t *proxy);
 
+/**
+ * Create an smr proxy in the epoch clock group of another proxy, the
+ * group leader.  Group members share the leader's epoch, refs and poll
+ * thread but have their own retire queue and batch destructors, so a
+ * single acquire of a ref from any proxy in the group protects objects
+ * retired to all of them.
+ *
+ * @param leader the group leader or another member of its group
+ * @param config smrproxy configuration or if NULL, use default configuration.
+ *   Only queue_size is used.
+ * @returns the smrproxy or NULL
+ *
+ * @note destroying a member waits until objects retired to it are reclaimed.
+ * Destroying the leader destroys all remaining members.
+*/
+extern smrproxy_t * smrproxy_create_member(smrproxy_t *leader, smrproxy_config_t *config);
+
 /**
  * Retire a data object asynchronously and set expiry epoch.
  * @param proxy the smr proxy
@@ -117,6 +206,183 @@ extern epoch_t smrproxy_retire_exp(smrproxy_t *proxy, void *data, void (*dtor)(v
 */
 extern epoch_t smrproxy_retire(smrproxy_t *proxy, void *data, void (*dtor)(void *));
 
+/**
+ * retire priorities
+ *   NORMAL  proxy's retire queue, same as smrproxy_retire
+ *   URGENT  for objects holding scarce resources, wakes the poll thread
+ *           and is polled every millisecond until reclaimed
+ *   LAZY    for small objects that can wait, doesn't advance the epoch,
+ *           wakes an idle poll thread only to start its poll timer,
+ *           reclaimed on the next poll
+*/
+#define SMRPROXY_PRIORITY_NORMAL 0
+#define SMRPROXY_PRIORITY_URGENT 1
+#define SMRPROXY_PRIORITY_LAZY 2
+
+/**
+ * Retire a data object asynchronously with a priority.  Urgent and lazy
+ * objects are kept in their own retire queues, each the size of the
+ * proxy's queue.
+ * @param proxy the smr proxy
+ * @param data address of data to be retired
+ * @param dtor destructor function for data
+ * @param priority SMRPROXY_PRIORITY_NORMAL, SMRPROXY_PRIORITY_URGENT or SMRPROXY_PRIORITY_LAZY
+ * @returns expiry epoch of retired object or 0 if no space to queue retirement
+*/
+extern epoch_t smrproxy_retire_priority(smrproxy_t *proxy, void *data, void (*dtor)(void *), int priority);
+
+/**
+ * Retire a data object to be freed by the thread owning ref rather than
+ * the poll thread, e.g. so the allocator frees it locally.  Once expired
+ * the object is put on ref's return list.  The owner frees returned
+ * objects with smrproxy_ref_drain, which is also called by each
+ * smrproxy_retire_owned.  Objects returned after ref is destroyed are
+ * freed by the poll thread.
+ * @param proxy the smr proxy
+ * @param ref calling thread's ref
+ * @param data address of data to be retired
+ * @param dtor destructor function for data
+ * @returns expiry epoch of retired object or 0 if no space to queue retirement
+*/
+extern epoch_t smrproxy_retire_owned(smrproxy_t *proxy, smrproxy_ref_t *ref, void *data, void (*dtor)(void *));
+
+/**
+ * Free objects returned to ref by owned retires, e.g. at a quiescent point.
+ * Only called by ref's owning thread.
+ * @param ref smrproxy reference
+ * @returns number of objects freed
+*/
+extern unsigned int smrproxy_ref_drain(smrproxy_ref_t *ref);
+
+/**
+ * Register a batch dtor.  Objects retired with dtor are no longer passed
+ * to dtor one at a time but collected as they are reclaimed and passed to
+ * batch as an array, at least once per reclaim pass.  Use to amortize
+ * per call setup over many objects.
+ *
+ * @param proxy the smr proxy
+ * @param dtor destructor function used to retire objects, e.g. free
+ * @param batch batch destructor for objects retired with dtor
+ * @returns 0 on success, -1 if SMRPROXY_MAX_BATCH batch dtors already registered
+*/
+extern int smrproxy_register_batch(smrproxy_t *proxy, void (*dtor)(void *), void (*batch)(void **objs, unsigned int count));
+
+/**
+ * Batch dtor for objects retired with free.  Prefetches ahead of each free.
+ * @param objs objects
+ * @param count number of objects
+*/
+extern void smrproxy_free_batch(void **objs, unsigned int count);
+
+/**
+ * Retired region release, munmap
+*/
+#define SMRPROXY_REGION_UNMAP 0
+
+/**
+ * Retired region release, madvise MADV_DONTNEED, region stays mapped
+*/
+#define SMRPROXY_REGION_DONTNEED 1
+
+/**
+ * Retire a large page aligned memory region, e.g. from mmap.  Regions
+ * reclaimed in the same reclaim pass are sorted and adjacent regions
+ * are released together, so there are fewer munmap or madvise calls and
+ * TLB shootdowns.  Unmap regions may be kept in the proxy's warm region
+ * cache instead, see smrproxy_region_cache.
+ * @param proxy the smr proxy
+ * @param addr start of region, page aligned
+ * @param size size of region, multiple of page size
+ * @param flags SMRPROXY_REGION_UNMAP or SMRPROXY_REGION_DONTNEED
+ * @returns expiry epoch of retired region or 0 if no space to queue retirement
+*/
+extern epoch_t smrproxy_retire_region(smrproxy_t *proxy, void *addr, size_t size, int flags);
+
+/**
+ * Set size of proxy's warm region cache.  Reclaimed unmap regions are
+ * kept mapped, up to max bytes, for reuse by smrproxy_region_alloc.
+ * @param proxy the smr proxy
+ * @param max cache size in bytes, 0, the default, to not cache regions
+ * @returns 0 on success or -1 if no memory
+*/
+extern int smrproxy_region_cache(smrproxy_t *proxy, size_t max);
+
+/**
+ * Allocate a memory region, a cached region of the same size if there
+ * is one, otherwise a new anonymous mapping.  Contents of a cached
+ * region are whatever they were when it was retired.
+ * @param proxy the smr proxy
+ * @param size size of region, multiple of page size
+ * @returns region or NULL
+*/
+extern void * smrproxy_region_alloc(smrproxy_t *proxy, size_t size);
+
+/**
+ * @brief opaque handle to a generation arena
+*/
+typedef struct smrproxy_arena_t smrproxy_arena_t;
+
+/**
+ * Create a generation arena, a bump pointer allocator for objects which
+ * are all retired together, e.g. the nodes of a rebuilt lookup table.
+ * Not thread safe, allocations are made by one writer thread.
+ * @param proxy the smr proxy
+ * @param chunk_size size of memory chunks, 0 for the default 1 MiB
+ * @returns the arena or NULL
+*/
+extern smrproxy_arena_t * smrproxy_arena_create(smrproxy_t *proxy, size_t chunk_size);
+
+/**
+ * Allocate an object from an arena.  Objects are aligned to the largest
+ * power of 2 dividing size, up to 16, and are not individually freed.
+ * @param arena the arena
+ * @param size object size
+ * @returns the object or NULL if no memory
+*/
+extern void * smrproxy_arena_alloc(smrproxy_arena_t *arena, size_t size);
+
+/**
+ * Retire the whole arena as a single retire queue entry.  All chunks are
+ * freed once no reader can reference any object allocated from it.  The
+ * arena's birth epoch is its creation epoch.
+ * @param arena the arena, not to be used after a successful retire
+ * @returns expiry epoch of retired arena or 0 if no space to queue retirement
+*/
+extern epoch_t smrproxy_arena_retire(smrproxy_arena_t *arena);
+
+/**
+ * Destroy an arena immediately, for arenas never published to readers.
+ * @param arena the arena
+*/
+extern void smrproxy_arena_destroy(smrproxy_arena_t *arena);
+
+/**
+ * @brief polled grace period cookie, an expiry epoch
+*/
+typedef epoch_t smrproxy_gp_cookie_t;
+
+/**
+ * Start a grace period without retiring anything.  Data unpublished
+ * before the call can be reused or freed by the caller once
+ * smrproxy_gp_done returns true for the returned cookie.  No retire queue
+ * entry or dtor is used.
+ * @param proxy the smr proxy
+ * @returns grace period cookie
+*/
+extern smrproxy_gp_cookie_t smrproxy_gp_start(smrproxy_t *proxy);
+
+/**
+ * Check if a grace period has ended, i.e. no reader that could have seen
+ * data unpublished before smrproxy_gp_start is still in a read section.
+ * Since the object isn't known, a grace period doesn't end while any
+ * reader holds a hazard pointer from smrproxy_ref_hold.
+ * A single load of the proxy's reclaimed epoch.
+ * @param proxy the smr proxy
+ * @param cookie cookie from smrproxy_gp_start
+ * @returns true if grace period has ended
+*/
+extern bool smrproxy_gp_done(smrproxy_t *proxy, smrproxy_gp_cookie_t cookie);
+
 /**
  * Create an smrproxy reference
  * 
@@ -132,6 +398,15 @@ extern smrproxy_ref_t * smrproxy_ref_create(smrproxy_t *proxy);
 */
 extern void smrproxy_ref_destroy(smrproxy_ref_t *ref);
 
+/**
+ * Get proxy statistics.
+ * Statistics are collected by retiring threads and the poll thread only.
+ *
+ * @param proxy the smrproxy
+ * @param stats statistics to be filled in
+*/
+extern void smrproxy_get_stats(smrproxy_t *proxy, smrproxy_stats_t *stats);
+
 /**
  * Acquire an smrproxy protected reference to current epoch
  * long
@@ -141,12 +416,23 @@ inline static void smrproxy_ref_acquire(smrproxy_ref_t *ref)
 {
     // __builtin_prefetch(ref, 1, 0);
 
+#ifndef SMRPROXY_CLOCK
     epoch_t *epoch = &ref->current_epoch;
+#endif
     epoch_t *ref_epoch = &ref->epoch;
 
     epoch_t local;
 
-#ifndef SMRPROXY_MB
+#if defined(SMRPROXY_CLOCK) && !defined(SMRPROXY_MB)
+    local = smrproxy_clock_epoch();     // no current_epoch, clock load ordered by fence below
+    atomic_store_explicit(ref_epoch, local, memory_order_relaxed);
+
+    atomic_thread_fence(memory_order_acquire);
+#elif defined(SMRPROXY_CLOCK)
+    local = smrproxy_clock_epoch();
+    atomic_store_explicit(ref_epoch, local, memory_order_seq_cst);
+    atomic_thread_fence(memory_order_acquire);
+#elif !defined(SMRPROXY_MB)
     local = atomic_load_explicit(epoch, memory_order_relaxed);
     atomic_store_explicit(ref_epoch, local, memory_order_relaxed);
 
@@ -164,6 +450,320 @@ inline static void smrproxy_ref_release(smrproxy_ref_t *ref)
     atomic_store_explicit(&ref->epoch, 0, memory_order_release);
 }
 
+/**
+ * Implicit thread local refs
+ *
+ * smrproxy_read_lock and smrproxy_read_unlock find the calling thread's
+ * ref for a proxy in a small initial-exec thread local cache, creating
+ * and registering the ref on first use, so refs don't have to be passed
+ * around.  Cache entries are invalidated whenever any proxy is destroyed.
+ * Initial-exec TLS is for executables and libraries loaded at startup.
+ * If the ref can't be created the process aborts, use smrproxy_ref_create
+ * with explicit refs where that has to be handled.
+*/
+
+#define SMRPROXY_TLS_CACHE 4
+
+typedef struct smrproxy_tls_entry_t {
+    smrproxy_t *proxy;
+    smrproxy_ref_t *ref;
+    unsigned long gen;              // smrproxy_tls_gen when cached
+} smrproxy_tls_entry_t;
+
+extern __thread smrproxy_tls_entry_t smrproxy_tls_cache[SMRPROXY_TLS_CACHE] __attribute__((tls_model("initial-exec")));
+extern unsigned long smrproxy_tls_gen;
+
+/**
+ * Get calling thread's ref, slow path, creates ref if needed and caches it.
+ * Aborts if the ref can't be created.
+ * @param proxy the smrproxy
+ * @returns the ref, never NULL
+*/
+extern smrproxy_ref_t * smrproxy_tls_ref(smrproxy_t *proxy);
+
+/**
+ * Get calling thread's ref for proxy, aborts if it can't be created.
+ * @param proxy the smrproxy
+ * @returns the ref, never NULL
+*/
+inline static smrproxy_ref_t * smrproxy_tls_get(smrproxy_t *proxy)
+{
+    unsigned long gen = atomic_load_explicit(&smrproxy_tls_gen, memory_order_relaxed);
+    for (int ndx = 0; ndx < SMRPROXY_TLS_CACHE; ndx++)
+    {
+        if (smrproxy_tls_cache[ndx].proxy == proxy && smrproxy_tls_cache[ndx].gen == gen)
+            return smrproxy_tls_cache[ndx].ref;
+    }
+    return smrproxy_tls_ref(proxy);
+}
+
+/**
+ * Acquire calling thread's implicit ref, aborts if it can't be created.
+ * @param proxy the smrproxy
+*/
+inline static void smrproxy_read_lock(smrproxy_t *proxy)
+{
+    smrproxy_ref_acquire(smrproxy_tls_get(proxy));
+}
+
+/**
+ * Release calling thread's implicit ref.
+ * @param proxy the smrproxy
+*/
+inline static void smrproxy_read_unlock(smrproxy_t *proxy)
+{
+    smrproxy_ref_release(smrproxy_tls_get(proxy));
+}
+
+/**
+ * Quiescent state based reclamation (QSBR)
+ *
+ * A QSBR reader stays online and, rather than acquiring and releasing
+ * around every access, calls smrproxy_quiescent at points where it holds
+ * no references to shared data, e.g. the top of its event loop.
+ * Reclamation is held back only to the epoch of the reader's last
+ * quiescent state.  A reader about to block should go offline so it does
+ * not hold back reclamation while blocked.
+*/
+
+/**
+ * Put a QSBR reader online.
+ * @param ref smrproxy reference
+*/
+inline static void smrproxy_ref_online(smrproxy_ref_t *ref)
+{
+    smrproxy_ref_acquire(ref);
+}
+
+/**
+ * Put a QSBR reader offline, e.g. before blocking.
+ * @param ref smrproxy reference
+*/
+inline static void smrproxy_ref_offline(smrproxy_ref_t *ref)
+{
+    smrproxy_ref_release(ref);
+}
+
+/**
+ * Announce a quiescent state for an online QSBR reader.
+ * References to shared data obtained before this call must not be used
+ * after it.  The ref epoch is only written when the reclaim thread has
+ * published a newer epoch.
+ * @param ref smrproxy reference
+*/
+inline static void smrproxy_quiescent(smrproxy_ref_t *ref)
+{
+#ifndef SMRPROXY_CLOCK
+    epoch_t local = atomic_load_explicit(&ref->current_epoch, memory_order_relaxed);
+#else
+    epoch_t local = smrproxy_clock_epoch();
+#endif
+
+    if (local != ref->epoch)
+    {
+#ifndef SMRPROXY_MB
+        atomic_store_explicit(&ref->epoch, local, memory_order_release);
+        atomic_thread_fence(memory_order_acquire);
+#else
+        atomic_store_explicit(&ref->epoch, local, memory_order_seq_cst);
+        atomic_thread_fence(memory_order_acquire);
+#endif
+    }
+}
+
+/**
+ * Convert the epoch protection of an acquired ref into a hazard pointer
+ * to a single object and release the epoch.  Only obj remains protected,
+ * so a long running reader no longer holds back reclamation of anything
+ * else.  Must be followed by smrproxy_ref_unhold before the ref is
+ * acquired again.
+ * @param ref smrproxy reference, acquired
+ * @param obj object obtained in the current read section
+*/
+inline static void smrproxy_ref_hold(smrproxy_ref_t *ref, void *obj)
+{
+    atomic_store_explicit(&ref->hazard, obj, memory_order_relaxed);
+    atomic_store_explicit(&ref->epoch, 0, memory_order_release);
+}
+
+/**
+ * Drop the hazard pointer set by smrproxy_ref_hold.
+ * @param ref smrproxy reference
+*/
+inline static void smrproxy_ref_unhold(smrproxy_ref_t *ref)
+{
+    atomic_store_explicit(&ref->hazard, NULL, memory_order_release);
+}
+
+/**
+ * Per cpu readers
+ *
+ * Readers which don't register a ref.  Reader counts are kept per cpu, so
+ * the poll thread scans one cache line per cpu however many reader threads
+ * there are.  Meant for processes with many more threads than cpus.  A
+ * reader may migrate between cpus inside its read section.
+*/
+
+/**
+ * Enter a per cpu read section.
+ * @param proxy the smrproxy
+ * @returns token to pass to smrproxy_cpu_read_unlock
+*/
+extern unsigned int smrproxy_cpu_read_lock(smrproxy_t *proxy);
+
+/**
+ * Leave a per cpu read section.
+ * @param proxy the smrproxy
+ * @param token from smrproxy_cpu_read_lock
+*/
+extern void smrproxy_cpu_read_unlock(smrproxy_t *proxy, unsigned int token);
+
+/**
+ * Interval based reclamation (IBR)
+ *
+ * Objects allocated with a birth epoch from smrproxy_birth_epoch and
+ * retired with smrproxy_retire_birth can be reclaimed while an older
+ * reader is still in its read section, as long as the object's lifetime,
+ * [birth, expiry], does not overlap the reader's reservation interval.
+ * An IBR reader loads shared pointers with smrproxy_ref_ibr_load which
+ * extends the upper bound of its interval as needed.  A stalled IBR
+ * reader then only holds back objects that existed while it was reading.
+ * Objects retired without a birth epoch are reclaimed as usual.
+*/
+
+/**
+ * Acquire an IBR reservation interval starting at the current epoch.
+ * @param ref smrproxy reference
+*/
+inline static void smrproxy_ref_ibr_acquire(smrproxy_ref_t *ref)
+{
+#ifndef SMRPROXY_CLOCK
+    epoch_t local = atomic_load_explicit(ref->proxy_epoch, memory_order_acquire);
+#else
+    epoch_t local = smrproxy_clock_epoch();
+#endif
+
+#ifndef SMRPROXY_MB
+    atomic_store_explicit(&ref->upper, local, memory_order_relaxed);
+    atomic_store_explicit(&ref->epoch, local, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+#else
+    atomic_store_explicit(&ref->upper, local, memory_order_seq_cst);
+    atomic_store_explicit(&ref->epoch, local, memory_order_seq_cst);
+    atomic_thread_fence(memory_order_acquire);
+#endif
+}
+
+/**
+ * Load a shared pointer inside an IBR read section, extending the
+ * reservation interval upper bound to cover the loaded object.
+ * @param ref smrproxy reference
+ * @param pptr address of shared pointer
+ * @returns the loaded pointer value
+*/
+inline static void * smrproxy_ref_ibr_load(smrproxy_ref_t *ref, void **pptr)
+{
+    for (;;)
+    {
+        void *ptr = atomic_load_explicit(pptr, memory_order_acquire);
+#ifndef SMRPROXY_CLOCK
+        epoch_t local = atomic_load_explicit(ref->proxy_epoch, memory_order_acquire);
+#else
+        epoch_t local = smrproxy_clock_epoch();
+#endif
+        if (local == ref->upper)
+            return ptr;
+
+#ifndef SMRPROXY_MB
+        atomic_store_explicit(&ref->upper, local, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+#else
+        atomic_store_explicit(&ref->upper, local, memory_order_seq_cst);
+        atomic_thread_fence(memory_order_acquire);
+#endif
+    }
+}
+
+/**
+ * Release an IBR reservation interval.
+ * @param ref smrproxy reference
+*/
+inline static void smrproxy_ref_ibr_release(smrproxy_ref_t *ref)
+{
+    atomic_store_explicit(&ref->epoch, 0, memory_order_release);
+    atomic_store_explicit(&ref->upper, 0, memory_order_relaxed);
+}
+
+/**
+ * Get the birth epoch for a newly allocated object.
+ * Call before the object is published.
+ * @param proxy the smrproxy
+ * @returns birth epoch
+*/
+extern epoch_t smrproxy_birth_epoch(smrproxy_t *proxy);
+
+/**
+ * Retire a data object with a birth epoch asynchronously.
+ * @param proxy the smr proxy
+ * @param data address of data to be retired
+ * @param dtor destructor function for data
+ * @param birth birth epoch of data from smrproxy_birth_epoch
+ * @returns expiry epoch of retired object or 0 if no space to queue retirement
+*/
+extern epoch_t smrproxy_retire_birth(smrproxy_t *proxy, void *data, void (*dtor)(void *), epoch_t birth);
+
+/**
+ * Get a task owned smrproxy reference from the proxy's reference pool.
+ * Unlike smrproxy_ref_create, the reference is not bound to the calling
+ * thread.  It may be moved between threads, e.g. by a coroutine or fiber
+ * that suspends inside a read section and resumes on another worker thread,
+ * using smrproxy_ref_handoff and smrproxy_ref_resume.
+ *
+ * @param proxy the smrproxy
+ * @return smrproxy reference or NULL
+*/
+extern smrproxy_ref_t * smrproxy_ref_get(smrproxy_t *proxy);
+
+/**
+ * Return a task owned smrproxy reference to the proxy's reference pool.
+ * The reference is released if still acquired.
+ *
+ * @param ref smrproxy reference from smrproxy_ref_get
+*/
+extern void smrproxy_ref_put(smrproxy_ref_t *ref);
+
+/**
+ * Prepare a task owned reference to be moved to another thread.
+ * Called on the current thread before the task is suspended.  Reads done
+ * in the read section so far are ordered before the handoff.
+ * @param ref smrproxy reference
+*/
+inline static void smrproxy_ref_handoff(smrproxy_ref_t *ref)
+{
+    (void) ref;
+#ifndef SMRPROXY_MB
+    atomic_thread_fence(memory_order_release);
+#else
+    atomic_thread_fence(memory_order_seq_cst);
+#endif
+}
+
+/**
+ * Take over a task owned reference moved from another thread.
+ * Called on the new thread after the task resumes and before any further
+ * reads in the read section.
+ * @param ref smrproxy reference
+*/
+inline static void smrproxy_ref_resume(smrproxy_ref_t *ref)
+{
+    (void) ref;
+#ifndef SMRPROXY_MB
+    atomic_thread_fence(memory_order_acquire);
+#else
+    atomic_thread_fence(memory_order_seq_cst);
+#endif
+}
+
 /*
  * experimental api
  * may be removed or changed
@@ -178,6 +778,29 @@ inline static void smrproxy_ref_release(smrproxy_ref_t *ref)
 */
 extern epoch_t smrproxy_get_epoch(smrproxy_t *proxy);
 
+/**
+ * Wait for the current epoch to change from seen, e.g. for a retire
+ * following a publish.  The proxy's epoch word is used as a futex and
+ * retires only make a wake call when there are waiters.  Read seen
+ * with smrproxy_get_epoch before checking for new data.
+ * With SMRPROXY_CLOCK, epochs advance with the clock rather than on
+ * retire, so this waits at most one clock tick.
+ * Spurious wakeups are possible, callers must recheck their condition.
+ *
+ * @param proxy the proxy
+ * @param seen epoch last seen
+ * @param abstime absolute TIME_UTC timeout or NULL to wait indefinitely
+ * @returns thrd_success, thrd_timedout, or thrd_error
+*/
+extern int smrproxy_wait_epoch(smrproxy_t *proxy, epoch_t seen, const struct timespec *abstime);
+
+/**
+ * Get the number of global memory barriers executed by the proxy.
+ * @param proxy the proxy
+ * @returns membarrier count
+*/
+extern unsigned long smrproxy_get_membar_count(smrproxy_t *proxy);
+
 /**
  * Set the reference epoch to node's expiry epoch if the object has been retired
  * or a recent current epoch value if the node is still live.  Any traveral of a
@@ -0,0 +1,191 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SMRSHM_H
+#define SMRSHM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <smrproxy.h>
+
+/**
+ * @brief process local handle to a shared memory smr proxy
+ *
+ * The proxy's epoch, reader slots and retire queue live in a caller
+ * supplied shared memory region, e.g. from mmap of a memfd or shm_open
+ * file, and contain only offsets so the region may be mapped at
+ * different addresses in different processes.  Retired objects are
+ * identified by their offset in the region and a destructor id.
+ *
+ * One designated process reclaims by calling smrshm_reclaim periodically,
+ * after registering destructors for the ids in use.  Any attached process
+ * may create reader refs and retire objects.
+ *
+ * Readers use smrshm_ref_acquire and smrshm_ref_release on the refs
+ * from smrshm_ref_create.  Shared memory proxies always use counter
+ * epochs, SMRPROXY_CLOCK doesn't apply to them.  smrproxy_ref_next and
+ * the IBR api are not supported on shared memory refs.
+*/
+typedef struct smrshm_t smrshm_t;
+
+/**
+ * maximum number of destructor ids
+*/
+#define SMRSHM_MAX_DTORS 16
+
+/**
+ * Shared memory object destructor
+ * @param base address the region is mapped at in the reclaiming process
+ * @param offset offset of retired object in the region
+*/
+typedef void (*smrshm_dtor_t)(void *base, uint64_t offset);
+
+/**
+ * Get size of shared memory needed for a proxy.  The proxy is placed at
+ * the start of the region; the application may use the rest of the
+ * region beyond this size.
+ *
+ * @param nslots maximum number of reader refs
+ * @param queue_size size of retire queue
+ * @returns size in bytes
+*/
+extern size_t smrshm_size(unsigned int nslots, unsigned int queue_size);
+
+/**
+ * Initialize a shared memory proxy at the start of a region and attach
+ * to it.  Done once by one process before any other process attaches.
+ *
+ * @param base address of region, must be cache line aligned
+ * @param size size of region
+ * @param nslots maximum number of reader refs
+ * @param queue_size size of retire queue
+ * @returns process local handle or NULL
+*/
+extern smrshm_t * smrshm_init(void *base, size_t size, unsigned int nslots, unsigned int queue_size);
+
+/**
+ * Attach to a shared memory proxy initialized by smrshm_init, possibly in
+ * another process.
+ *
+ * @param base address of region in this process
+ * @param size size of region
+ * @returns process local handle or NULL if region not initialized
+ *   or cross process memory barriers are not available.
+*/
+extern smrshm_t * smrshm_attach(void *base, size_t size);
+
+/**
+ * Detach from a shared memory proxy.  Refs created by this process are
+ * destroyed.  The region itself is left as is.
+ *
+ * @param shm process local handle
+*/
+extern void smrshm_detach(smrshm_t *shm);
+
+/**
+ * Get a reader ref slot.
+ *
+ * @param shm process local handle
+ * @returns ref or NULL if all slots are in use
+*/
+extern smrproxy_ref_t * smrshm_ref_create(smrshm_t *shm);
+
+/**
+ * Return a reader ref slot.
+ *
+ * @param ref ref from smrshm_ref_create
+*/
+extern void smrshm_ref_destroy(smrproxy_ref_t *ref);
+
+/**
+ * Acquire a shared memory ref, protecting objects read until release.
+ * Same as smrproxy_ref_acquire without SMRPROXY_CLOCK.
+ *
+ * @param ref ref from smrshm_ref_create
+*/
+inline static void smrshm_ref_acquire(smrproxy_ref_t *ref)
+{
+    epoch_t local = atomic_load_explicit(&ref->current_epoch, memory_order_relaxed);
+#ifndef SMRPROXY_MB
+    atomic_store_explicit(&ref->epoch, local, memory_order_relaxed);
+#else
+    atomic_store_explicit(&ref->epoch, local, memory_order_seq_cst);
+#endif
+    atomic_thread_fence(memory_order_acquire);
+}
+
+/**
+ * Release a shared memory ref.
+ *
+ * @param ref ref from smrshm_ref_create
+*/
+inline static void smrshm_ref_release(smrproxy_ref_t *ref)
+{
+    atomic_store_explicit(&ref->epoch, 0, memory_order_release);
+}
+
+/**
+ * Retire a shared memory object.
+ *
+ * @param shm process local handle
+ * @param offset offset of object in the region
+ * @param dtor_id registered destructor id
+ * @returns expiry epoch of retired object or 0 if no space to queue retirement
+*/
+extern epoch_t smrshm_retire(smrshm_t *shm, uint64_t offset, unsigned int dtor_id);
+
+/**
+ * Register a destructor in the reclaiming process.
+ *
+ * @param shm process local handle
+ * @param dtor_id destructor id, less than SMRSHM_MAX_DTORS
+ * @param dtor destructor
+ * @returns 0 on success or -1 if dtor_id is out of range
+*/
+extern int smrshm_register_dtor(smrshm_t *shm, unsigned int dtor_id, smrshm_dtor_t dtor);
+
+/**
+ * Reclaim retired objects no longer referenced by any reader in any
+ * process.  Only called from the designated reclaiming process.
+ * Slots of reader processes which have exited are freed, whether or not
+ * they exited in a read section, when there are retired objects to
+ * reclaim.
+ *
+ * @param shm process local handle
+ * @returns number of objects reclaimed
+*/
+extern unsigned int smrshm_reclaim(smrshm_t *shm);
+
+/**
+ * Convert an offset in the region to an address in this process.
+*/
+extern void * smrshm_ptr(smrshm_t *shm, uint64_t offset);
+
+/**
+ * Convert an address in the region to an offset.
+*/
+extern uint64_t smrshm_offset(smrshm_t *shm, void *ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SMRSHM_H */
@@ -0,0 +1,93 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SMRTRACE_H
+#define SMRTRACE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <smrproxy.h>
+
+/**
+ * Binary trace of proxy activity for offline replay, e.g. with test/replay.
+ *
+ * The trace file is a header followed by a ring of fixed size records,
+ * written through a shared memory mapping.  Records are written by the
+ * retiring threads and the poll thread while holding the proxy mutex,
+ * so recording adds no synchronization of its own.  Reader epochs are
+ * sampled by the poll thread as it scans refs, readers are not slowed.
+ * Once the ring is full the oldest records are overwritten.
+*/
+
+#define SMRTRACE_MAGIC 0x74726d73   // "smrt"
+#define SMRTRACE_VERSION 1
+
+/*
+* record types, fields a, b, c
+*/
+typedef enum {
+    SMRTRACE_RETIRE = 1,    // expiry, birth, queue depth
+    SMRTRACE_REF,           // ref id, ref epoch or 0, effective epoch
+    SMRTRACE_SCAN,          // current epoch, oldest, refs
+    SMRTRACE_RECLAIM,       // head, new head, count
+    SMRTRACE_MEMBAR,        // epoch, nanoseconds
+} smrtrace_type_t;
+
+typedef struct smrtrace_rec_t {
+    uint64_t time;          // nanoseconds since trace start
+    uint32_t type;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+} smrtrace_rec_t;
+
+typedef struct smrtrace_header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;      // number of records in ring
+    uint64_t count;         // records written, ring index is count % capacity
+    uint32_t queue_size;    // config of traced proxy
+    uint32_t polltime;
+} smrtrace_header_t;
+
+/**
+ * Start recording a trace of proxy activity to a file.
+ * Any trace already being recorded is stopped first.
+ *
+ * @param proxy the smr proxy
+ * @param path trace file, created or truncated
+ * @param capacity number of records in ring
+ * @returns 0 on success, -1 on error
+*/
+extern int smrproxy_trace_start(smrproxy_t *proxy, const char *path, size_t capacity);
+
+/**
+ * Stop recording a trace.  The trace file is left as is.
+ *
+ * @param proxy the smr proxy
+*/
+extern void smrproxy_trace_stop(smrproxy_t *proxy);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SMRTRACE_H */
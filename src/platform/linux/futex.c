@@ -0,0 +1,63 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+   
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdint.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <threads.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static long futex(uint32_t *uaddr, int op, uint32_t val, const struct timespec *timeout, uint32_t val3)
+{
+	return syscall(__NR_futex, uaddr, op, val, timeout, NULL, val3);
+}
+
+/**
+ * Wait while *addr == val.
+ * Spurious wakeups are possible, callers must recheck their condition.
+ *
+ * @param addr futex word
+ * @param val expected value
+ * @param abstime absolute TIME_UTC timeout or NULL to wait indefinitely
+ * @returns thrd_success, thrd_timedout, or thrd_error
+*/
+int smr_futex_wait(uint32_t *addr, uint32_t val, const struct timespec *abstime)
+{
+	long rc = futex(addr, FUTEX_WAIT_BITSET_PRIVATE | FUTEX_CLOCK_REALTIME, val, abstime, FUTEX_BITSET_MATCH_ANY);
+	if (rc == 0)
+		return thrd_success;
+
+	switch (errno) {
+	case EAGAIN:
+	case EINTR:
+		return thrd_success;
+	case ETIMEDOUT:
+		return thrd_timedout;
+	default:
+		return thrd_error;
+	}
+}
+
+/**
+ * Wake all waiters on addr.
+*/
+void smr_futex_wake(uint32_t *addr)
+{
+	futex(addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, 0);
+}
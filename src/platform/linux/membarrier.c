@@ -23,7 +23,8 @@
 #define MB_CMD MEMBARRIER_CMD_PRIVATE_EXPEDITED
 
 typedef struct smrproxy_membar_t {
-	int x;
+	int cmd;		// membarrier command used by sync
+	unsigned long count;	// number of syncs
 } smrproxy_membar_t;
 
 static int membarrier(int cmd, unsigned int flags, int cpu_id)
@@ -35,6 +36,34 @@ smrproxy_membar_t *smrproxy_membar_create()
 {
 	membarrier(MB_REGISTER, 0, 0);
 	smrproxy_membar_t *mb = malloc(sizeof(smrproxy_membar_t));
+	if (mb != NULL) {
+		mb->cmd = MB_CMD;
+		mb->count = 0;
+	}
+	return mb;
+}
+
+/*
+* Global expedited membarrier only reaches processes which have registered
+* for it, so every process sharing the memory must create one of these.
+* Falls back to the slower non-expedited global membarrier if expedited
+* is not supported.
+*/
+smrproxy_membar_t *smrproxy_membar_create_global()
+{
+	int cmd = MEMBARRIER_CMD_GLOBAL_EXPEDITED;
+	if (membarrier(MEMBARRIER_CMD_REGISTER_GLOBAL_EXPEDITED, 0, 0) != 0) {
+		int cmds = membarrier(MEMBARRIER_CMD_QUERY, 0, 0);
+		if (cmds < 0 || (cmds & MEMBARRIER_CMD_GLOBAL) == 0)
+			return NULL;
+		cmd = MEMBARRIER_CMD_GLOBAL;
+	}
+
+	smrproxy_membar_t *mb = malloc(sizeof(smrproxy_membar_t));
+	if (mb != NULL) {
+		mb->cmd = cmd;
+		mb->count = 0;
+	}
 	return mb;
 }
 
@@ -47,8 +76,11 @@ void smrproxy_membar_sync(smrproxy_membar_t * membar)
 {
 	if (membar == NULL)
 		return;
-	membarrier(MB_CMD, 0, 0);
+	membarrier(membar->cmd, 0, 0);
+	membar->count++;
 }
 
-
-
+unsigned long smrproxy_membar_count(smrproxy_membar_t * membar)
+{
+	return membar != NULL ? membar->count : 0;
+}
@@ -14,7 +14,13 @@
    limitations under the License.
 */
 
+#define _GNU_SOURCE
+#include <sched.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <stdint.h>
+#include <time.h>
 
 static int names[] = {
     _SC_LEVEL3_CACHE_LINESIZE,
@@ -33,3 +39,58 @@ long getcachesize() {
     return -1;
 }
 
+/*
+* time in nanoseconds, monotonic where available
+*/
+uint64_t smr_gettime() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+* current cpu, sched_getcpu reads the rseq cpu id where glibc supports it
+*/
+unsigned int smr_getcpu() {
+    int cpu = sched_getcpu();
+    return cpu >= 0 ? cpu : 0;
+}
+
+unsigned int smr_getncpu() {
+    long ncpu = sysconf(_SC_NPROCESSORS_CONF);
+    return ncpu > 0 ? ncpu : 1;
+}
+
+/*
+* map file of given size, shared, read/write, created or truncated
+*/
+void *smr_map_file(const char *path, size_t size) {
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        return NULL;
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        return NULL;
+    }
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return addr != MAP_FAILED ? addr : NULL;
+}
+
+void smr_unmap_file(void *addr, size_t size) {
+    msync(addr, size, MS_ASYNC);
+    munmap(addr, size);
+}
+
+void *smr_map_region(size_t size) {
+    void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return addr != MAP_FAILED ? addr : NULL;
+}
+
+void smr_unmap_region(void *addr, size_t size) {
+    munmap(addr, size);
+}
+
+void smr_discard_region(void *addr, size_t size) {
+    madvise(addr, size, MADV_DONTNEED);
+}
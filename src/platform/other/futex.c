@@ -0,0 +1,45 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+   
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <threads.h>
+
+/**
+ * Polling fallback for platforms without a futex.
+ * Sleeps briefly and returns, which callers treat as a spurious wakeup.
+*/
+int smr_futex_wait(uint32_t *addr, uint32_t val, const struct timespec *abstime)
+{
+	if (atomic_load_explicit(addr, memory_order_acquire) != val)
+		return thrd_success;
+
+	if (abstime != NULL) {
+		struct timespec now;
+		timespec_get(&now, TIME_UTC);
+		if (now.tv_sec > abstime->tv_sec || (now.tv_sec == abstime->tv_sec && now.tv_nsec >= abstime->tv_nsec))
+			return thrd_timedout;
+	}
+
+	struct timespec ts = { 0, 1000000 };
+	thrd_sleep(&ts, NULL);
+	return thrd_success;
+}
+
+void smr_futex_wake(uint32_t *addr)
+{
+}
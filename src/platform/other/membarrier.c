@@ -17,15 +17,25 @@
 #include <stdlib.h>
 
 typedef struct smrproxy_membar_t {
-	int x;
+	unsigned long count;	// number of syncs
 } smrproxy_membar_t;
 
 smrproxy_membar_t *smrproxy_membar_create()
 {
 	smrproxy_membar_t *mb = malloc(sizeof(smrproxy_membar_t));
+	if (mb != NULL)
+		mb->count = 0;
 	return mb;
 }
 
+/*
+* No cross process memory barrier, same as smrproxy_membar_create.
+*/
+smrproxy_membar_t *smrproxy_membar_create_global()
+{
+	return smrproxy_membar_create();
+}
+
 void smrproxy_membar_destroy(smrproxy_membar_t * membar)
 {
 	free(membar);
@@ -38,7 +48,11 @@ void smrproxy_membar_destroy(smrproxy_membar_t * membar)
 */
 void smrproxy_membar_sync(smrproxy_membar_t * membar)
 {
+	if (membar != NULL)
+		membar->count++;
 }
 
-
-
+unsigned long smrproxy_membar_count(smrproxy_membar_t * membar)
+{
+	return membar != NULL ? membar->count : 0;
+}
@@ -14,7 +14,53 @@
    limitations under the License.
 */
 
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
 long getcachesize() {
     return -1;             // application should provide cacheline size.
 }
 
+/*
+* time in nanoseconds, monotonic where available
+*/
+uint64_t smr_gettime() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/*
+* cpu not known, per cpu readers share one set of counters
+*/
+unsigned int smr_getcpu() {
+    return 0;
+}
+
+unsigned int smr_getncpu() {
+    return 1;
+}
+
+/*
+* file mapping not supported, trace recorder unavailable
+*/
+void *smr_map_file(const char *path, size_t size) {
+    return NULL;
+}
+
+void smr_unmap_file(void *addr, size_t size) {
+}
+
+/*
+* memory regions not supported, retired regions are leaked
+*/
+void *smr_map_region(size_t size) {
+    return NULL;
+}
+
+void smr_unmap_region(void *addr, size_t size) {
+}
+
+void smr_discard_region(void *addr, size_t size) {
+}
@@ -0,0 +1,128 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <smrproxy_intr.h>
+
+#define ARENA_CHUNK_SIZE (1 << 20)  // default chunk size
+#define ARENA_ALIGN 16              // max natural alignment
+
+/*
+* arena chunk, an anonymous mapping, allocations follow the header
+*/
+typedef struct smrarena_chunk_t {
+    struct smrarena_chunk_t *next;
+    size_t size;                    // mapping size
+} smrarena_chunk_t;
+
+typedef struct smrproxy_arena_t {
+    smrproxy_t *proxy;
+    epoch_t birth;                  // generation birth epoch
+    size_t chunk_size;
+
+    char *next;                     // bump pointer into current chunk
+    char *end;
+    smrarena_chunk_t *chunks;       // all chunks, freed together
+} smrproxy_arena_t;
+
+#define ARENA_HEADER ((sizeof(smrarena_chunk_t) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+
+static void arena_free(void *obj)
+{
+    smrproxy_arena_t *arena = obj;
+    smrarena_chunk_t *chunk = arena->chunks;
+    while (chunk != NULL)
+    {
+        smrarena_chunk_t *next = chunk->next;
+        smr_unmap_region(chunk, chunk->size);
+        chunk = next;
+    }
+    free(arena);
+}
+
+smrproxy_arena_t * smrproxy_arena_create(smrproxy_t *proxy, size_t chunk_size)
+{
+    smrproxy_arena_t *arena = malloc(sizeof(smrproxy_arena_t));
+    if (arena == NULL)
+        return NULL;
+
+    arena->proxy = proxy;
+    arena->birth = smrproxy_birth_epoch(proxy);
+    arena->chunk_size = chunk_size > ARENA_HEADER ? chunk_size : ARENA_CHUNK_SIZE;
+    arena->next = NULL;
+    arena->end = NULL;
+    arena->chunks = NULL;
+    return arena;
+}
+
+void smrproxy_arena_destroy(smrproxy_arena_t *arena)
+{
+    arena_free(arena);
+}
+
+/**
+ * Map a new chunk and add it to the arena's chunk list.
+ * @returns start of chunk's allocation space or NULL if no memory
+*/
+static char * arena_map(smrproxy_arena_t *arena, size_t size)
+{
+    smrarena_chunk_t *chunk = smr_map_region(size);
+    if (chunk == NULL)
+        return NULL;
+    chunk->size = size;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    return (char *) chunk + ARENA_HEADER;
+}
+
+void * smrproxy_arena_alloc(smrproxy_arena_t *arena, size_t size)
+{
+    /*
+    * natural alignment, largest power of 2 dividing size up to ARENA_ALIGN,
+    * so e.g. 24 byte nodes are packed at 8 byte alignment
+    */
+    size_t align = size & -size;
+    if (align == 0 || align > ARENA_ALIGN)
+        align = ARENA_ALIGN;
+
+    uintptr_t addr = ((uintptr_t) arena->next + align - 1) & ~(uintptr_t) (align - 1);
+    if (arena->next != NULL && addr + size <= (uintptr_t) arena->end)
+    {
+        arena->next = (char *) (addr + size);
+        return (void *) addr;
+    }
+
+    if (size > arena->chunk_size - ARENA_HEADER)
+        return arena_map(arena, ARENA_HEADER + size);   // own chunk, current chunk's remaining space kept
+
+    char *next = arena_map(arena, arena->chunk_size);
+    if (next == NULL)
+        return NULL;
+    arena->next = next + size;
+    arena->end = (char *) arena->chunks + arena->chunk_size;
+    return next;
+}
+
+epoch_t smrproxy_arena_retire(smrproxy_arena_t *arena)
+{
+    return smrproxy_retire_birth(arena->proxy, arena, &arena_free, arena->birth);
+}
+
+/*-*/
@@ -0,0 +1,252 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include <string.h>
+
+#include <smrproxy_intr.h>
+#include <smrevent.h>
+
+/*
+* event queue node
+*
+* A node is retired once it has a successor, in queue order, so
+* expiry epochs are monotonic along the queue as smrproxy_ref_next
+* requires.  The queue tail is never retired.
+*/
+typedef struct event_node_t {
+    epoch_t expiry;                 // expiry epoch or 0 if not retired yet
+    struct event_node_t *next;
+
+    void *event;
+    void (*dtor)(void *);           // event destructor or NULL
+} event_node_t;
+
+typedef struct smrevent_t {
+    smrproxy_t *proxy;
+    void (*dtor)(void *);
+
+    event_node_t *tail;             // last published node
+
+    event_node_t *retire_next;      // oldest node not retired yet
+    atomic_flag retiring;           // retire_next owner
+
+    uint32_t seq;                   // publish count, used as futex word
+    atomic_uint waiters;            // listeners waiting on seq
+} smrevent_t;
+
+typedef struct smrevent_listener_t {
+    smrevent_t *queue;
+    smrproxy_ref_t *ref;
+    event_node_t *node;             // last read node
+} smrevent_listener_t;
+
+static epoch_t getexpiry(void *x, void *ctx)
+{
+    (void) ctx;
+    event_node_t *node = x;
+    return atomic_load_explicit(&node->expiry, memory_order_relaxed);
+}
+
+static void setexpiry(epoch_t expiry, void *x, void *ctx)
+{
+    (void) ctx;
+    event_node_t *node = x;
+    atomic_store_explicit(&node->expiry, expiry, memory_order_relaxed);
+}
+
+static void free_node(void *x)
+{
+    event_node_t *node = x;
+    if (node->dtor != NULL && node->event != NULL)
+        (node->dtor)(node->event);
+    free(node);
+}
+
+static event_node_t * node_create(void *event, void (*dtor)(void *))
+{
+    event_node_t *node = malloc(sizeof(event_node_t));
+    if (node == NULL)
+        return NULL;
+
+    node->expiry = 0;
+    node->next = NULL;
+    node->event = event;
+    node->dtor = dtor;
+    return node;
+}
+
+smrevent_t * smrevent_create(smrproxy_t *proxy, void (*dtor)(void *))
+{
+    smrevent_t *queue = malloc(sizeof(smrevent_t));
+    if (queue == NULL)
+        return NULL;
+    memset(queue, 0, sizeof(smrevent_t));
+
+    queue->proxy = proxy;
+    queue->dtor = dtor;
+
+    queue->tail = node_create(NULL, NULL);
+    if (queue->tail == NULL)
+    {
+        free(queue);
+        return NULL;
+    }
+    queue->retire_next = queue->tail;
+    atomic_flag_clear(&queue->retiring);
+
+    return queue;
+}
+
+void smrevent_destroy(smrevent_t *queue)
+{
+    event_node_t *node = queue->retire_next;
+    while (node != NULL)
+    {
+        event_node_t *next = node->next;
+        while (smrproxy_retire_exp(queue->proxy, node, &free_node, &setexpiry, NULL) == 0)
+            thrd_yield();       // retire queue full
+        node = next;
+    }
+
+    memset(queue, 0, sizeof(smrevent_t));
+    free(queue);
+}
+
+/**
+ * Retire linked nodes in queue order.
+ *
+ * Only one producer at a time retires.  A producer that loses the race
+ * relies on the owner rechecking for newly linked nodes after it lets go.
+ * If the proxy retire queue is full the owner yields until the poll
+ * thread makes room, so no node is left unretired.
+*/
+static void retire_linked(smrevent_t *queue)
+{
+    while (!atomic_flag_test_and_set_explicit(&queue->retiring, memory_order_seq_cst))
+    {
+        event_node_t *node = queue->retire_next;
+        event_node_t *next;
+
+        while ((next = atomic_load_explicit(&node->next, memory_order_acquire)) != NULL)
+        {
+            while (smrproxy_retire_exp(queue->proxy, node, &free_node, &setexpiry, NULL) == 0)
+                thrd_yield();       // retire queue full
+            node = next;
+        }
+        queue->retire_next = node;
+
+        atomic_flag_clear_explicit(&queue->retiring, memory_order_seq_cst);
+
+        if (atomic_load_explicit(&node->next, memory_order_seq_cst) == NULL)
+            break;
+    }
+}
+
+int smrevent_publish(smrevent_t *queue, void *event)
+{
+    event_node_t *node = node_create(event, queue->dtor);
+    if (node == NULL)
+        return thrd_nomem;
+
+    event_node_t *prev = atomic_exchange_explicit(&queue->tail, node, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, node, memory_order_seq_cst);
+
+    atomic_fetch_add_explicit(&queue->seq, 1, memory_order_seq_cst);
+    if (atomic_load_explicit(&queue->waiters, memory_order_seq_cst) != 0)
+        smr_futex_wake(&queue->seq);
+
+    retire_linked(queue);
+    return thrd_success;
+}
+
+smrevent_listener_t * smrevent_listen(smrevent_t *queue)
+{
+    smrevent_listener_t *listener = malloc(sizeof(smrevent_listener_t));
+    if (listener == NULL)
+        return NULL;
+
+    listener->queue = queue;
+    listener->ref = smrproxy_ref_create(queue->proxy);
+    if (listener->ref == NULL)
+    {
+        free(listener);
+        return NULL;
+    }
+
+    smrproxy_ref_acquire(listener->ref);
+    listener->node = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    return listener;
+}
+
+void smrevent_unlisten(smrevent_listener_t *listener)
+{
+    smrproxy_ref_release(listener->ref);
+    free(listener);
+}
+
+size_t smrevent_read(smrevent_listener_t *listener, void **events, size_t count)
+{
+    event_node_t *node = listener->node;
+
+    /*
+    * release events from previous read, the last read
+    * node is still needed to find its successors.
+    */
+    smrproxy_ref_next(listener->ref, &getexpiry, node, NULL);
+
+    size_t ndx = 0;
+    while (ndx < count)
+    {
+        event_node_t *next = atomic_load_explicit(&node->next, memory_order_acquire);
+        if (next == NULL)
+            break;
+        events[ndx++] = next->event;
+        node = next;
+    }
+
+    listener->node = node;
+    return ndx;
+}
+
+int smrevent_wait(smrevent_listener_t *listener, const struct timespec *abstime)
+{
+    smrevent_t *queue = listener->queue;
+    event_node_t *node = listener->node;
+    int rc = thrd_success;
+
+    atomic_fetch_add_explicit(&queue->waiters, 1, memory_order_seq_cst);
+
+    for (;;)
+    {
+        uint32_t seq = atomic_load_explicit(&queue->seq, memory_order_seq_cst);
+        if (atomic_load_explicit(&node->next, memory_order_seq_cst) != NULL)
+            break;
+
+        rc = smr_futex_wait(&queue->seq, seq, abstime);
+        if (rc != thrd_success)
+            break;
+    }
+
+    atomic_fetch_sub_explicit(&queue->waiters, 1, memory_order_relaxed);
+    return rc;
+}
+
+/*-*/
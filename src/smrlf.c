@@ -0,0 +1,341 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include <smrproxy_intr.h>
+#include <smrlf.h>
+
+/*
+* fixed, keeps head and tail on separate cache lines
+*/
+#define LF_LINE 128
+
+/*
+* queue and stack node
+*
+* A node's next pointer is not changed once the node is removed, so a
+* reader still holding a removed node follows it back into the container
+* or to other removed nodes, which are not freed until the reader's read
+* section ends.
+*/
+typedef struct lf_node_t {
+    _Atomic(struct lf_node_t *) next;
+    void *value;
+
+    unsigned int count;             // number of nodes in removed chain, first node only
+    struct lf_node_t *pending;      // next chain on pending list
+} lf_node_t;
+
+typedef struct smrmsq_t {
+    _Alignas(LF_LINE) _Atomic(lf_node_t *) head;      // dummy node, values start at head->next
+    _Alignas(LF_LINE) _Atomic(lf_node_t *) tail;
+    _Alignas(LF_LINE) _Atomic(lf_node_t *) pending;   // removed chains not yet retired
+    smrproxy_t *proxy;
+    void (*dtor)(void *);
+} smrmsq_t;
+
+typedef struct smrstack_t {
+    _Alignas(LF_LINE) _Atomic(lf_node_t *) head;
+    _Alignas(LF_LINE) _Atomic(lf_node_t *) pending;
+    smrproxy_t *proxy;
+    void (*dtor)(void *);
+} smrstack_t;
+
+static lf_node_t * node_create(void *value)
+{
+    lf_node_t *node = malloc(sizeof(lf_node_t));
+    if (node == NULL)
+        return NULL;
+    atomic_init(&node->next, NULL);
+    node->value = value;
+    node->count = 0;
+    node->pending = NULL;
+    return node;
+}
+
+/*
+* retire dtor, free chain of count nodes linked by next
+*/
+static void free_chain(void *x)
+{
+    lf_node_t *node = x;
+    for (unsigned int ndx = x != NULL ? node->count : 0; ndx > 0; ndx--)
+    {
+        lf_node_t *next = atomic_load_explicit(&node->next, memory_order_relaxed);
+        free(node);
+        node = next;
+    }
+}
+
+static void push_pending(_Atomic(lf_node_t *) *pending, lf_node_t *chain)
+{
+    lf_node_t *head = atomic_load_explicit(pending, memory_order_relaxed);
+    do {
+        chain->pending = head;
+    } while (!atomic_compare_exchange_weak_explicit(pending, &head, chain, memory_order_release, memory_order_relaxed));
+}
+
+/*
+* retire chains left pending when the retire queue was full
+*/
+static void flush_pending(smrproxy_t *proxy, _Atomic(lf_node_t *) *pending)
+{
+    lf_node_t *chain = atomic_exchange_explicit(pending, NULL, memory_order_acquire);
+    while (chain != NULL)
+    {
+        lf_node_t *next = chain->pending;
+        if (smrproxy_retire(proxy, chain, &free_chain) == 0)
+        {
+            for (; chain != NULL; chain = next)     // still full, put back
+            {
+                next = chain->pending;
+                push_pending(pending, chain);
+            }
+            return;
+        }
+        chain = next;
+    }
+}
+
+/*
+* retire chain of count removed nodes as one retire queue entry
+*/
+static void retire_chain(smrproxy_t *proxy, _Atomic(lf_node_t *) *pending, lf_node_t *chain, unsigned int count)
+{
+    chain->count = count;
+    if (smrproxy_retire(proxy, chain, &free_chain) == 0)
+        push_pending(pending, chain);       // retire queue full, can't wait inside a read section
+    else if (atomic_load_explicit(pending, memory_order_relaxed) != NULL)
+        flush_pending(proxy, pending);
+}
+
+static void destroy_pending(_Atomic(lf_node_t *) *pending)
+{
+    lf_node_t *chain = atomic_load_explicit(pending, memory_order_relaxed);
+    while (chain != NULL)
+    {
+        lf_node_t *next = chain->pending;
+        free_chain(chain);
+        chain = next;
+    }
+}
+
+/*
+* Michael-Scott queue
+*/
+
+smrmsq_t * smrmsq_create(smrproxy_t *proxy, void (*dtor)(void *))
+{
+    smrmsq_t *queue = aligned_alloc(LF_LINE, sizeof(smrmsq_t));
+    if (queue == NULL)
+        return NULL;
+    memset(queue, 0, sizeof(smrmsq_t));
+
+    lf_node_t *dummy = node_create(NULL);
+    if (dummy == NULL)
+    {
+        free(queue);
+        return NULL;
+    }
+
+    atomic_init(&queue->head, dummy);
+    atomic_init(&queue->tail, dummy);
+    atomic_init(&queue->pending, NULL);
+    queue->proxy = proxy;
+    queue->dtor = dtor;
+    return queue;
+}
+
+void smrmsq_destroy(smrmsq_t *queue)
+{
+    lf_node_t *node = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    lf_node_t *next = atomic_load_explicit(&node->next, memory_order_relaxed);
+    free(node);
+    for (node = next; node != NULL; node = next)
+    {
+        next = atomic_load_explicit(&node->next, memory_order_relaxed);
+        if (queue->dtor != NULL)
+            (*queue->dtor)(node->value);
+        free(node);
+    }
+
+    destroy_pending(&queue->pending);
+
+    memset(queue, 0, sizeof(smrmsq_t));
+    free(queue);
+}
+
+bool smrmsq_enqueue(smrmsq_t *queue, void *value)
+{
+    lf_node_t *node = node_create(value);
+    if (node == NULL)
+        return false;
+
+    for (;;)
+    {
+        lf_node_t *tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        lf_node_t *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+        if (next != NULL)
+        {
+            atomic_compare_exchange_strong_explicit(&queue->tail, &tail, next, memory_order_release, memory_order_relaxed);
+            continue;       // tail lagging, help and retry
+        }
+
+        if (atomic_compare_exchange_weak_explicit(&tail->next, &next, node, memory_order_release, memory_order_relaxed))
+        {
+            atomic_compare_exchange_strong_explicit(&queue->tail, &tail, node, memory_order_release, memory_order_relaxed);
+            return true;
+        }
+    }
+}
+
+unsigned int smrmsq_dequeue_batch(smrmsq_t *queue, void **values, unsigned int count)
+{
+    for (;;)
+    {
+        lf_node_t *head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+        /*
+        * head and the first n - 1 value nodes are removed,
+        * node, the nth value node, becomes the new dummy
+        */
+        lf_node_t *node = head;
+        lf_node_t *next;
+        unsigned int n = 0;
+        while (n < count && (next = atomic_load_explicit(&node->next, memory_order_acquire)) != NULL)
+        {
+            values[n++] = next->value;
+            node = next;
+        }
+        if (n == 0)
+            return 0;
+
+        /*
+        * tail mustn't be left pointing to a removed node
+        */
+        lf_node_t *tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        lf_node_t *p = head;
+        while (p != node && p != tail)
+            p = atomic_load_explicit(&p->next, memory_order_acquire);
+        if (p == tail && p != node)
+        {
+            atomic_compare_exchange_strong_explicit(&queue->tail, &tail, node, memory_order_release, memory_order_relaxed);
+            continue;
+        }
+
+        if (atomic_compare_exchange_strong_explicit(&queue->head, &head, node, memory_order_acq_rel, memory_order_relaxed))
+        {
+            retire_chain(queue->proxy, &queue->pending, head, n);
+            return n;
+        }
+    }
+}
+
+bool smrmsq_dequeue(smrmsq_t *queue, void **pvalue)
+{
+    return smrmsq_dequeue_batch(queue, pvalue, 1) == 1;
+}
+
+/*
+* Treiber stack
+*/
+
+smrstack_t * smrstack_create(smrproxy_t *proxy, void (*dtor)(void *))
+{
+    smrstack_t *stack = aligned_alloc(LF_LINE, sizeof(smrstack_t));
+    if (stack == NULL)
+        return NULL;
+    memset(stack, 0, sizeof(smrstack_t));
+
+    atomic_init(&stack->head, NULL);
+    atomic_init(&stack->pending, NULL);
+    stack->proxy = proxy;
+    stack->dtor = dtor;
+    return stack;
+}
+
+void smrstack_destroy(smrstack_t *stack)
+{
+    lf_node_t *node = atomic_load_explicit(&stack->head, memory_order_relaxed);
+    while (node != NULL)
+    {
+        lf_node_t *next = atomic_load_explicit(&node->next, memory_order_relaxed);
+        if (stack->dtor != NULL)
+            (*stack->dtor)(node->value);
+        free(node);
+        node = next;
+    }
+
+    destroy_pending(&stack->pending);
+
+    memset(stack, 0, sizeof(smrstack_t));
+    free(stack);
+}
+
+bool smrstack_push(smrstack_t *stack, void *value)
+{
+    lf_node_t *node = node_create(value);
+    if (node == NULL)
+        return false;
+
+    lf_node_t *head = atomic_load_explicit(&stack->head, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&node->next, head, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&stack->head, &head, node, memory_order_release, memory_order_relaxed));
+    return true;
+}
+
+unsigned int smrstack_pop_batch(smrstack_t *stack, void **values, unsigned int count)
+{
+    if (count == 0)
+        return 0;
+
+    lf_node_t *head = atomic_load_explicit(&stack->head, memory_order_acquire);
+    unsigned int n;
+    for (;;)
+    {
+        if (head == NULL)
+            return 0;
+
+        lf_node_t *node = head;
+        lf_node_t *next = atomic_load_explicit(&node->next, memory_order_acquire);
+        values[0] = node->value;
+        n = 1;
+        while (n < count && next != NULL)
+        {
+            node = next;
+            values[n++] = node->value;
+            next = atomic_load_explicit(&node->next, memory_order_acquire);
+        }
+
+        if (atomic_compare_exchange_weak_explicit(&stack->head, &head, next, memory_order_acq_rel, memory_order_acquire))
+            break;
+    }
+
+    retire_chain(stack->proxy, &stack->pending, head, n);
+    return n;
+}
+
+bool smrstack_pop(smrstack_t *stack, void **pvalue)
+{
+    return smrstack_pop_batch(stack, pvalue, 1) == 1;
+}
+
+/*-*/
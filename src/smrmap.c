@@ -0,0 +1,365 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include <string.h>
+
+#include <smrproxy_intr.h>
+#include <smrmap.h>
+
+#define MAX_LEVEL 24
+#define DEFAULT_BATCH 64
+
+/*
+* skiplist node
+*
+* Next pointers of an unlinked node are never modified again, so they
+* only point to nodes that were unlinked later or are still live.  Since
+* nodes are retired in unlink order, expiry epochs are monotonic along
+* any traversal, which smrproxy_ref_next requires.
+*/
+typedef struct map_node_t {
+    epoch_t expiry;                 // expiry epoch or 0 if not retired
+    unsigned int height;
+
+    uint64_t key;
+    void *value;
+
+    struct map_node_t *retired;     // next node in retire batch
+    struct map_node_t *next[];
+} map_node_t;
+
+typedef struct smrmap_t {
+    smrproxy_t *proxy;
+    void (*dtor)(void *);
+
+    mtx_t mutex;                    // serializes writers
+    uint64_t seed;                  // random height state
+    unsigned int level;             // highest level in use
+
+    map_node_t *pending;            // unlinked nodes not retired yet
+    unsigned int npending;
+    unsigned int batch;
+
+    map_node_t *head;               // sentinel, MAX_LEVEL high
+} smrmap_t;
+
+/*
+* retire batch, all nodes in the batch share one retire queue entry
+*/
+typedef struct {
+    void (*dtor)(void *);           // value destructor or NULL
+    map_node_t *nodes;              // linked through retired
+} map_batch_t;
+
+static epoch_t getexpiry(void *x, void *ctx)
+{
+    (void) ctx;
+    map_node_t *node = x;
+    return atomic_load_explicit(&node->expiry, memory_order_relaxed);
+}
+
+static void setexpiry(epoch_t expiry, void *x, void *ctx)
+{
+    (void) ctx;
+    map_batch_t *batch = x;
+    for (map_node_t *node = batch->nodes; node != NULL; node = node->retired)
+        atomic_store_explicit(&node->expiry, expiry, memory_order_relaxed);
+}
+
+static void free_batch(void *x)
+{
+    map_batch_t *batch = x;
+    map_node_t *node = batch->nodes;
+    while (node != NULL)
+    {
+        map_node_t *retired = node->retired;
+        if (batch->dtor != NULL && node->value != NULL)
+            (*batch->dtor)(node->value);
+        free(node);
+        node = retired;
+    }
+    free(batch);
+}
+
+static map_node_t * node_create(unsigned int height, uint64_t key, void *value)
+{
+    map_node_t *node = malloc(sizeof(map_node_t) + height * sizeof(map_node_t *));
+    if (node == NULL)
+        return NULL;
+
+    node->expiry = 0;
+    node->height = height;
+    node->key = key;
+    node->value = value;
+    node->retired = NULL;
+    memset(node->next, 0, height * sizeof(map_node_t *));
+    return node;
+}
+
+static unsigned int random_height(smrmap_t *map)
+{
+    // xorshift64
+    uint64_t x = map->seed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    map->seed = x;
+
+    unsigned int height = 1 + __builtin_ctzll(x | (1ull << (MAX_LEVEL - 1)));
+    return height;
+}
+
+smrmap_t * smrmap_create(smrproxy_t *proxy, void (*dtor)(void *), unsigned int batch)
+{
+    smrmap_t *map = malloc(sizeof(smrmap_t));
+    if (map == NULL)
+        return NULL;
+    memset(map, 0, sizeof(smrmap_t));
+
+    map->head = node_create(MAX_LEVEL, 0, NULL);
+    if (map->head == NULL)
+    {
+        free(map);
+        return NULL;
+    }
+
+    map->proxy = proxy;
+    map->dtor = dtor;
+    map->seed = 0x9e3779b97f4a7c15ull ^ (uintptr_t) map;
+    map->level = 1;
+    map->batch = batch != 0 ? batch : DEFAULT_BATCH;
+    mtx_init(&map->mutex, mtx_plain);
+
+    return map;
+}
+
+/*
+* mutex must be held
+*/
+static void add_pending(smrmap_t *map, map_node_t *node)
+{
+    node->retired = map->pending;
+    map->pending = node;
+    map->npending++;
+}
+
+/**
+ * Retire pending nodes as a single batch.
+ * The batch carries the value dtor so it does not reference the map,
+ * which may be gone by the time the batch is reclaimed.
+ *
+ * mutex must be held.
+*/
+static bool flush_pending(smrmap_t *map)
+{
+    if (map->pending == NULL)
+        return true;
+
+    map_batch_t *batch = malloc(sizeof(map_batch_t));
+    if (batch == NULL)
+        return false;
+    batch->dtor = map->dtor;
+    batch->nodes = map->pending;
+
+    if (smrproxy_retire_exp(map->proxy, batch, &free_batch, &setexpiry, NULL) == 0)
+    {
+        free(batch);
+        return false;   // retire queue full, retry later
+    }
+
+    map->pending = NULL;
+    map->npending = 0;
+    return true;
+}
+
+void smrmap_destroy(smrmap_t *map)
+{
+    mtx_lock(&map->mutex);
+
+    map_node_t *node = map->head->next[0];
+    while (node != NULL)
+    {
+        map_node_t *next = node->next[0];
+        add_pending(map, node);
+        node = next;
+    }
+
+    while (!flush_pending(map))
+        thrd_yield();       // retire queue full
+
+    mtx_unlock(&map->mutex);
+
+    mtx_destroy(&map->mutex);
+    free(map->head);
+    memset(map, 0, sizeof(smrmap_t));
+    free(map);
+}
+
+/*
+* find predecessors of key at every level, writer only
+*/
+static map_node_t * find_preds(smrmap_t *map, uint64_t key, map_node_t **preds)
+{
+    map_node_t *pred = map->head;
+    for (int level = MAX_LEVEL - 1; level >= 0; level--)
+    {
+        map_node_t *next;
+        while ((next = pred->next[level]) != NULL && next->key < key)
+            pred = next;
+        preds[level] = pred;
+    }
+
+    map_node_t *node = pred->next[0];
+    if (node != NULL && node->key == key)
+        return node;
+    else
+        return NULL;
+}
+
+int smrmap_put(smrmap_t *map, uint64_t key, void *value)
+{
+    map_node_t *preds[MAX_LEVEL];
+
+    mtx_lock(&map->mutex);
+
+    map_node_t *old = find_preds(map, key, preds);
+
+    unsigned int height = old != NULL ? old->height : random_height(map);
+    map_node_t *node = node_create(height, key, value);
+    if (node == NULL)
+    {
+        mtx_unlock(&map->mutex);
+        return thrd_nomem;
+    }
+
+    if (old != NULL)
+    {
+        /*
+        * replace in place, readers see either the old or the new node
+        */
+        for (unsigned int level = 0; level < height; level++)
+            node->next[level] = old->next[level];
+        for (unsigned int level = 0; level < height; level++)
+            atomic_store_explicit(&preds[level]->next[level], node, memory_order_release);
+
+        add_pending(map, old);
+    }
+
+    else
+    {
+        for (unsigned int level = 0; level < height; level++)
+            node->next[level] = preds[level]->next[level];
+        for (unsigned int level = 0; level < height; level++)
+            atomic_store_explicit(&preds[level]->next[level], node, memory_order_release);
+
+        if (height > map->level)
+            atomic_store_explicit(&map->level, height, memory_order_relaxed);
+    }
+
+    if (map->npending >= map->batch)
+        flush_pending(map);
+
+    mtx_unlock(&map->mutex);
+    return thrd_success;
+}
+
+bool smrmap_remove(smrmap_t *map, uint64_t key)
+{
+    map_node_t *preds[MAX_LEVEL];
+
+    mtx_lock(&map->mutex);
+
+    map_node_t *node = find_preds(map, key, preds);
+    if (node == NULL)
+    {
+        mtx_unlock(&map->mutex);
+        return false;
+    }
+
+    for (int level = node->height - 1; level >= 0; level--)
+        atomic_store_explicit(&preds[level]->next[level], node->next[level], memory_order_release);
+
+    add_pending(map, node);
+
+    if (map->npending >= map->batch)
+        flush_pending(map);
+
+    mtx_unlock(&map->mutex);
+    return true;
+}
+
+bool smrmap_flush(smrmap_t *map)
+{
+    mtx_lock(&map->mutex);
+    bool rc = flush_pending(map);
+    mtx_unlock(&map->mutex);
+    return rc;
+}
+
+/*
+* find first node with key >= key, reader
+*/
+static map_node_t * find_ge(smrmap_t *map, uint64_t key)
+{
+    map_node_t *pred = map->head;
+    int level = atomic_load_explicit(&map->level, memory_order_relaxed);
+    for (level--; level >= 0; level--)
+    {
+        map_node_t *next;
+        while ((next = atomic_load_explicit(&pred->next[level], memory_order_acquire)) != NULL && next->key < key)
+            pred = next;
+    }
+
+    return atomic_load_explicit(&pred->next[0], memory_order_acquire);
+}
+
+void * smrmap_get(smrmap_t *map, uint64_t key)
+{
+    map_node_t *node = find_ge(map, key);
+    if (node != NULL && node->key == key)
+        return node->value;
+    else
+        return NULL;
+}
+
+size_t smrmap_scan(smrmap_t *map, smrproxy_ref_t *ref, uint64_t lo, uint64_t hi, bool (*fn)(uint64_t key, void *value, void *ctx), void *ctx)
+{
+    size_t count = 0;
+
+    map_node_t *node = find_ge(map, lo);
+    while (node != NULL && node->key <= hi)
+    {
+        /*
+        * node is protected by the current ref epoch, moving the epoch up to
+        * node's expiry releases the nodes already scanned.
+        */
+        smrproxy_ref_next(ref, &getexpiry, node, NULL);
+
+        count++;
+        if (!(*fn)(node->key, node->value, ctx))
+            break;
+
+        node = atomic_load_explicit(&node->next[0], memory_order_acquire);
+    }
+
+    return count;
+}
+
+/*-*/
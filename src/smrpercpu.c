@@ -0,0 +1,167 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include <smrproxy_intr.h>
+
+/*
+* Per cpu readers
+*
+* Two phases of per cpu lock and unlock counters, as in SRCU.  A reader
+* counts itself into the current phase on whatever cpu it is running on
+* and counts itself out on whatever cpu it is then running on.  A phase
+* has no readers when the sums of its lock and unlock counts are equal.
+*
+* The poll thread, right after a membarrier, checks whether the old phase
+* has drained and if so flips the current phase.  Readers of the current
+* phase started after the membarrier preceding the flip, so can only hold
+* objects with expiries at or after the epoch synced by that membarrier.
+*/
+
+typedef struct {
+    atomic_ulong lock[2];
+    atomic_ulong unlock[2];
+} cpu_counts_t;
+
+typedef struct smrproxy_percpu_t {
+    atomic_uint phase;          // current phase
+    atomic_bool used;           // set by first reader
+
+    epoch_t phase_epoch[2];     // synced epoch when phase became current
+    bool old_active;            // old phase not yet drained
+
+    unsigned int ncpu;
+    size_t stride;              // cache line multiple
+    char *counts;
+} smrproxy_percpu_t;
+
+static inline cpu_counts_t * get_counts(smrproxy_percpu_t *percpu, unsigned int cpu)
+{
+    return (cpu_counts_t *) (percpu->counts + (cpu % percpu->ncpu) * percpu->stride);
+}
+
+smrproxy_percpu_t * smrpercpu_create(epoch_t epoch, long cachesize)
+{
+    smrproxy_percpu_t *percpu = malloc(sizeof(smrproxy_percpu_t));
+    if (percpu == NULL)
+        return NULL;
+
+    percpu->ncpu = smr_getncpu();
+    percpu->stride = ((sizeof(cpu_counts_t) + cachesize - 1) / cachesize) * cachesize;
+    percpu->counts = aligned_alloc(cachesize, percpu->ncpu * percpu->stride);
+    if (percpu->counts == NULL)
+    {
+        free(percpu);
+        return NULL;
+    }
+    memset(percpu->counts, 0, percpu->ncpu * percpu->stride);
+
+    percpu->phase = 0;
+    percpu->used = false;
+    percpu->phase_epoch[0] = epoch;
+    percpu->phase_epoch[1] = epoch;
+    percpu->old_active = false;
+
+    return percpu;
+}
+
+void smrpercpu_destroy(smrproxy_percpu_t *percpu)
+{
+    if (percpu == NULL)
+        return;
+    free(percpu->counts);
+    free(percpu);
+}
+
+/**
+ * Per cpu readers need a membarrier on every poll, the old phase is only
+ * known to be drained right after one.
+ * @returns true if per cpu readers have been used
+*/
+bool smrpercpu_used(smrproxy_percpu_t *percpu)
+{
+    return atomic_load_explicit(&percpu->used, memory_order_relaxed);
+}
+
+static bool drained(smrproxy_percpu_t *percpu, unsigned int phase)
+{
+    unsigned long unlocks = 0;
+    for (unsigned int cpu = 0; cpu < percpu->ncpu; cpu++)
+        unlocks += atomic_load_explicit(&get_counts(percpu, cpu)->unlock[phase], memory_order_relaxed);
+
+    atomic_thread_fence(memory_order_seq_cst);
+
+    unsigned long locks = 0;
+    for (unsigned int cpu = 0; cpu < percpu->ncpu; cpu++)
+        locks += atomic_load_explicit(&get_counts(percpu, cpu)->lock[phase], memory_order_relaxed);
+
+    return locks == unlocks;
+}
+
+/**
+ * Advance per cpu reader phases, called right after a membarrier.
+ *
+ * @param percpu
+ * @param sync_epoch epoch synced by the membarrier
+ * @returns oldest epoch possibly referenced by per cpu readers
+*/
+epoch_t smrpercpu_poll(smrproxy_percpu_t *percpu, epoch_t sync_epoch)
+{
+    unsigned int phase = atomic_load_explicit(&percpu->phase, memory_order_relaxed);
+    unsigned int old = phase ^ 1;
+
+    if (percpu->old_active && drained(percpu, old))
+        percpu->old_active = false;
+
+    if (!percpu->old_active)
+    {
+        percpu->phase_epoch[old] = sync_epoch;
+        atomic_store_explicit(&percpu->phase, old, memory_order_release);
+        percpu->old_active = true;
+        old = phase;
+    }
+
+    return percpu->phase_epoch[old];
+}
+
+unsigned int smrproxy_cpu_read_lock(smrproxy_t *proxy)
+{
+    smrproxy_percpu_t *percpu = proxy->group->percpu;
+
+    if (!atomic_load_explicit(&percpu->used, memory_order_relaxed))
+        atomic_store_explicit(&percpu->used, true, memory_order_relaxed);
+
+    unsigned int phase = atomic_load_explicit(&percpu->phase, memory_order_relaxed);
+    atomic_fetch_add_explicit(&get_counts(percpu, smr_getcpu())->lock[phase], 1, memory_order_relaxed);
+
+#ifndef SMRPROXY_MB
+    atomic_thread_fence(memory_order_acquire);
+#else
+    atomic_thread_fence(memory_order_seq_cst);
+#endif
+
+    return phase;
+}
+
+void smrproxy_cpu_read_unlock(smrproxy_t *proxy, unsigned int token)
+{
+    smrproxy_percpu_t *percpu = proxy->group->percpu;
+    atomic_fetch_add_explicit(&get_counts(percpu, smr_getcpu())->unlock[token], 1, memory_order_release);
+}
@@ -20,10 +20,16 @@
 #include <threads.h>
 #include <string.h>
 #include <errno.h>
+#include <limits.h>
 
 #include <smrproxy_intr.h>
+#include <smrproxy_trace.h>
+#include <smrtrace.h>
 
 
+__thread smrproxy_tls_entry_t smrproxy_tls_cache[SMRPROXY_TLS_CACHE] __attribute__((tls_model("initial-exec")));
+unsigned long smrproxy_tls_gen = 0;
+
 static smrproxy_config_t default_config = {
     200,    // 200 retire queue sloots
     50,     // 50 msec poll interval
@@ -39,6 +45,37 @@ smrproxy_config_t *smrproxy_default_config()
 
 static int *smrproxy_poll3(void *arg);
 
+/**
+ * Get current epoch, the proxy epoch or with SMRPROXY_CLOCK the clock epoch.
+ * @param proxy
+ * @returns current epoch
+*/
+static inline epoch_t proxy_epoch(smrproxy_t *proxy)
+{
+#ifndef SMRPROXY_CLOCK
+    return atomic_load_explicit(proxy->epoch, memory_order_acquire);
+#else
+    return smrproxy_clock_epoch();
+#endif
+}
+
+#ifndef SMRPROXY_CLOCK
+/**
+ * Advance the group epoch, waking smrproxy_wait_epoch waiters if any.
+ * mutex must be held.
+ * @param group group leader
+ * @param epoch new epoch
+*/
+static inline void advance_epoch(smrproxy_t *group, epoch_t epoch)
+{
+    atomic_store_explicit(group->epoch, epoch, memory_order_seq_cst);
+    if (atomic_load_explicit(&group->epoch_waiters, memory_order_seq_cst) != 0)
+        smr_futex_wake(group->epoch);
+}
+#endif
+
+static bool smrproxy_hold(void *ctx, void *obj, void (*dtor)(void *));
+
 smrproxy_t * smrproxy_create(smrproxy_config_t *config)
 {
     if (config == NULL)
@@ -60,14 +97,52 @@ smrproxy_t * smrproxy_create(smrproxy_config_t *config)
 
     proxy->epoch = aligned_alloc(cachesize, cachesize);     // cachesize > sizeof epoch_t
 
+#ifndef SMRPROXY_CLOCK
     epoch_t epoch = 1;
+#else
+    epoch_t epoch = smrproxy_clock_epoch();
+#endif
     *proxy->epoch = epoch;
-    proxy->head = epoch;
+    atomic_init(&proxy->head, epoch);
+    atomic_init(&proxy->gp_head, epoch);
+    proxy->gp_epoch = epoch - 2;
     proxy->sync_epoch = epoch - 2;  // ?
 
     proxy->refs = NULL;
+    proxy->pool = NULL;
+
+    proxy->queue = smrqueue_create(config->queue_size);
+
+    proxy->group = proxy;
+    proxy->members = NULL;
+    proxy->member_next = NULL;
+
+    memset(proxy->lanes, 0, sizeof(proxy->lanes));
+    proxy->priority = SMRPROXY_PRIORITY_NORMAL;
+    proxy->lazy_epoch = epoch - 2;
+    proxy->lazy_wake = false;
+    atomic_init(&proxy->epoch_waiters, 0);
+
+    proxy->ibr_lo = NULL;
+    proxy->ibr_hi = NULL;
+    proxy->ibr_count = 0;
+    proxy->ibr_size = 0;
+
+    proxy->hazards = NULL;
+    proxy->hazard_count = 0;
+    proxy->hazard_size = 0;
+    proxy->hazards_overflow = false;
+    proxy->held = NULL;
+
+    proxy->trace = NULL;
+    proxy->ref_ids = 0;
+
+    proxy->percpu = smrpercpu_create(epoch, cachesize);      // TODO test return value
+    proxy->regions = NULL;
 
-    proxy->queue = smrqueue_create(*proxy->epoch, config->queue_size);
+    memset(&proxy->stats, 0, sizeof(smrproxy_stats_t));
+
+    smrqueue_set_hold(proxy->queue, &smrproxy_hold, proxy);
 
     proxy->active = true;
     /*
@@ -81,8 +156,87 @@ smrproxy_t * smrproxy_create(smrproxy_config_t *config)
     return proxy;
 }
 
+static epoch_t smrproxy_poll(smrproxy_t *proxy);
+static inline int poll_wait(smrproxy_t *proxy);
+
+smrproxy_t * smrproxy_create_member(smrproxy_t *leader, smrproxy_config_t *config)
+{
+    if (config == NULL)
+        config = &default_config;
+
+    leader = leader->group;
+
+    smrproxy_t *proxy = malloc(sizeof(smrproxy_t));
+    if (proxy == NULL)
+        return NULL;
+    memset(proxy, 0, sizeof(smrproxy_t));
+    proxy->config = *config;
+    proxy->config.cachesize = leader->config.cachesize;
+
+    proxy->queue = smrqueue_create(config->queue_size);
+    if (proxy->queue == NULL)
+    {
+        free(proxy);
+        return NULL;
+    }
+    smrqueue_set_hold(proxy->queue, &smrproxy_hold, leader);   // leader collects hazard pointers
+
+    proxy->epoch = leader->epoch;
+    proxy->group = leader;
+
+    mtx_lock(&leader->mutex);
+    proxy->member_next = leader->members;
+    leader->members = proxy;
+    mtx_unlock(&leader->mutex);
+
+    return proxy;
+}
+
+/**
+ * Destroy a group member, waiting for its retired objects to be reclaimed.
+ * The group's refs are the leader's and may still be in use.
+*/
+static void smrproxy_member_destroy(smrproxy_t *proxy)
+{
+    smrproxy_t *group = proxy->group;
+
+    for (int ndx = 0; ndx < SMRPROXY_LANES; ndx++)
+    {
+        if (proxy->lanes[ndx] != NULL)
+            smrproxy_member_destroy(proxy->lanes[ndx]);
+    }
+
+    mtx_lock(&group->mutex);
+
+    while (!smrqueue_empty(proxy->queue))
+    {
+        smrproxy_poll(group);
+        if (!smrqueue_empty(proxy->queue))
+            poll_wait(group);
+    }
+
+    smrproxy_t **pprev = &group->members;
+    while (*pprev != proxy)
+        pprev = &(*pprev)->member_next;
+    *pprev = proxy->member_next;
+
+    mtx_unlock(&group->mutex);
+
+    smrqueue_destroy(proxy->queue);
+    smrregion_cache_destroy(proxy->regions);
+    memset(proxy, 0, sizeof(smrproxy_t));
+    atomic_fetch_add_explicit(&smrproxy_tls_gen, 1, memory_order_relaxed);     // invalidate thread local caches
+    free(proxy);
+}
+
 void smrproxy_destroy(smrproxy_t *proxy)
 {
+    if (proxy->group != proxy)
+    {
+        smrproxy_member_destroy(proxy);
+        return;
+    }
+
     mtx_lock(&proxy->mutex);
 
     if (proxy->poll_thread != NULL) {
@@ -98,57 +252,107 @@ void smrproxy_destroy(smrproxy_t *proxy)
 
     mtx_unlock(&proxy->mutex);
 
+    smrproxy_trace_stop(proxy);
 
-    // delete all refs
+    // delete all refs, pooled refs included
+    proxy->pool = NULL;
     while (proxy->refs != NULL) {
         // TODO add tid to ref in ref create and print diagnostics
         smrproxy_ref_destroy((smrproxy_ref_t *)proxy->refs);
     }
 
 
-    smr_dequeue(proxy->queue, *proxy->epoch);
+    proxy->hazard_count = 0;    // refs are gone, nothing is hazard protected
+    proxy->hazards_overflow = false;
+
+    epoch_t end = proxy_epoch(proxy) + 2;   // past every expiry
+    smr_dequeue(proxy->queue, end);
+
+    while (proxy->members != NULL)
+    {
+        smrproxy_t *member = proxy->members;
+        proxy->members = member->member_next;
+        smr_dequeue(member->queue, end);
+        smrqueue_destroy(member->queue);
+        smrregion_cache_destroy(member->regions);
+        free(member);
+    }
+
+    while (proxy->held != NULL)
+    {
+        smrproxy_held_t *held = proxy->held;
+        proxy->held = held->next;
+        (held->dtor)(held->obj);
+        free(held);
+    }
 
     smrqueue_destroy(proxy->queue);
+    smrregion_cache_destroy(proxy->regions);
     smrproxy_membar_destroy(proxy->membar);
 
+    free(proxy->ibr_lo);
+    free(proxy->ibr_hi);
+    free(proxy->hazards);
+    smrpercpu_destroy(proxy->percpu);
+
     tss_delete(proxy->key);
     cnd_destroy(&proxy->cvar);
     mtx_destroy(&proxy->mutex);
 
     free(proxy->epoch);
     memset(proxy, 0, sizeof(smrproxy_t));
+    atomic_fetch_add_explicit(&smrproxy_tls_gen, 1, memory_order_relaxed);     // invalidate thread local caches
     free(proxy);
 }
 
-static smrproxy_ref_ex_t * smrproxy_ref_ex_create(smrproxy_t *proxy)
+/**
+ * Allocate and register a new ref.
+ * @param proxy
+ * @returns the ref or NULL
+*/
+static smrproxy_ref_ex_t * smrproxy_ref_ex_alloc(smrproxy_t *proxy)
 {
-    smrproxy_ref_ex_t *ref_ex = tss_get(proxy->key);
-    if (ref_ex != NULL)
-    {
-        return ref_ex;
-    }
-
     size_t cachesize = proxy->config.cachesize;
 
-    size_t size = ((sizeof(smrproxy_ref_t) + cachesize - 1)/cachesize)*cachesize;
-    ref_ex = aligned_alloc(cachesize, size);
+    size_t ref_size = ((sizeof(smrproxy_ref_ex_t) + cachesize - 1)/cachesize)*cachesize;
+    size_t size = ref_size + cachesize;     // reclaimer owned state on the following cache line
+    smrproxy_ref_ex_t *ref_ex = aligned_alloc(cachesize, size);
     if (ref_ex == NULL)
         return  NULL;
 
     memset(ref_ex, 0, size);
     ref_ex->proxy = proxy;
+    ref_ex->scan = (smrproxy_ref_scan_t *) ((char *) ref_ex + ref_size);
 
     mtx_lock(&proxy->mutex);
 
     ref_ex->ref.proxy_epoch = proxy->epoch;
     ref_ex->ref.epoch = 0;
-    ref_ex->ref.current_epoch = *proxy->epoch;
-    ref_ex->ref.effective_epoch = *proxy->epoch;
+    ref_ex->ref.current_epoch = proxy_epoch(proxy);
+    ref_ex->scan->effective_epoch = ref_ex->ref.current_epoch;
 
+    ref_ex->id = ++proxy->ref_ids;
     ref_ex->next = proxy->refs;
     proxy->refs = ref_ex;
     mtx_unlock(&proxy->mutex);
 
+    SMR_PROBE2(ref_create, ref_ex, proxy);
+
+    return ref_ex;
+}
+
+static smrproxy_ref_ex_t * smrproxy_ref_ex_create(smrproxy_t *proxy)
+{
+    smrproxy_ref_ex_t *ref_ex = tss_get(proxy->key);
+    if (ref_ex != NULL)
+    {
+        return ref_ex;
+    }
+
+    ref_ex = smrproxy_ref_ex_alloc(proxy);
+    if (ref_ex == NULL)
+        return NULL;
+
     tss_set(proxy->key, ref_ex);
 
     return ref_ex;
@@ -156,8 +360,22 @@ static smrproxy_ref_ex_t * smrproxy_ref_ex_create(smrproxy_t *proxy)
 
 smrproxy_ref_t * smrproxy_ref_create(smrproxy_t *proxy)
 {
-    smrproxy_ref_ex_t *ref_ex = smrproxy_ref_ex_create(proxy);
-    return &ref_ex->ref;
+    smrproxy_ref_ex_t *ref_ex = smrproxy_ref_ex_create(proxy->group);
+    return ref_ex != NULL ? &ref_ex->ref : NULL;
+}
+
+smrproxy_ref_t * smrproxy_tls_ref(smrproxy_t *proxy)
+{
+    smrproxy_ref_t *ref = smrproxy_ref_create(proxy);
+    if (ref == NULL)
+        abort();        // smrproxy_read_lock has no way to fail
+
+    // most recently used first
+    memmove(&smrproxy_tls_cache[1], &smrproxy_tls_cache[0], (SMRPROXY_TLS_CACHE - 1) * sizeof(smrproxy_tls_entry_t));
+    smrproxy_tls_cache[0].proxy = proxy;
+    smrproxy_tls_cache[0].ref = ref;
+    smrproxy_tls_cache[0].gen = atomic_load_explicit(&smrproxy_tls_gen, memory_order_relaxed);
+    return ref;
 }
 
 static void smrproxy_ref_ex_destroy(smrproxy_ref_ex_t *ref_ex)
@@ -173,15 +391,39 @@ static void smrproxy_ref_ex_destroy(smrproxy_ref_ex_t *ref_ex)
         tss_set(proxy->key, NULL);
     }
 
+    for (int ndx = 0; ndx < SMRPROXY_TLS_CACHE; ndx++)
+    {
+        if (smrproxy_tls_cache[ndx].ref == &ref_ex->ref)
+            smrproxy_tls_cache[ndx].proxy = NULL;
+    }
+
 /*
     if (ref->epoch != 0)
         ;   // error;  TODO do a release ?
 */
 
+    smrproxy_ref_drain(&ref_ex->ref);
+
     int rc = mtx_lock(&proxy->mutex);
     if (rc != thrd_success)
         return;
 
+    smrproxy_returns_t *returns = ref_ex->returns;
+    if (returns != NULL)
+    {
+        smrproxy_ref_drain(&ref_ex->ref);      // returned since drain above
+        while (returns->cells != NULL)
+        {
+            smrproxy_return_t *cell = returns->cells;
+            returns->cells = cell->next;
+            free(cell);
+        }
+        if (atomic_load_explicit(&returns->pending, memory_order_relaxed) == 0)
+            free(returns);
+        else
+            returns->orphaned = true;           // freed by last return
+    }
+
     if (proxy->refs == ref_ex) {
         proxy->refs = ref_ex->next;
     }
@@ -198,16 +440,138 @@ static void smrproxy_ref_ex_destroy(smrproxy_ref_ex_t *ref_ex)
             ;   // error
     }
 
+    SMR_PROBE2(ref_destroy, ref_ex, proxy);
+
     free(ref_ex);
 
     mtx_unlock(&proxy->mutex);
 }
 
+/**
+ * Queue dtor for owned retires, return object to owner's return list.
+ * Proxy mutex held.
+*/
+static void smrproxy_return(void *obj)
+{
+    smrproxy_return_t *cell = obj;
+    smrproxy_returns_t *returns = cell->returns;
+    atomic_fetch_sub_explicit(&returns->pending, 1, memory_order_relaxed);
+
+    if (returns->orphaned)
+    {
+        (cell->dtor)(cell->obj);
+        free(cell);
+        if (atomic_load_explicit(&returns->pending, memory_order_relaxed) == 0)
+            free(returns);
+        return;
+    }
+
+    smrproxy_return_t *head = atomic_load_explicit(&returns->head, memory_order_relaxed);
+    do {
+        cell->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&returns->head, &head, cell, memory_order_release, memory_order_relaxed));
+}
+
+epoch_t smrproxy_retire_owned(smrproxy_t *proxy, smrproxy_ref_t *ref, void *data, void (*dtor)(void *))
+{
+    smrproxy_ref_ex_t *ref_ex = (smrproxy_ref_ex_t *) ref;
+
+    smrproxy_ref_drain(ref);
+
+    smrproxy_returns_t *returns = ref_ex->returns;
+    if (returns == NULL)
+    {
+        returns = malloc(sizeof(smrproxy_returns_t));
+        if (returns == NULL)
+            return 0;
+        atomic_init(&returns->head, NULL);
+        atomic_init(&returns->pending, 0);
+        returns->orphaned = false;
+        returns->cells = NULL;
+        ref_ex->returns = returns;
+    }
+
+    smrproxy_return_t *cell = returns->cells;
+    if (cell != NULL)
+        returns->cells = cell->next;
+    else if ((cell = malloc(sizeof(smrproxy_return_t))) == NULL)
+        return 0;
+
+    cell->obj = data;
+    cell->dtor = dtor;
+    cell->returns = returns;
+
+    atomic_fetch_add_explicit(&returns->pending, 1, memory_order_relaxed);
+    epoch_t epoch = smrproxy_retire(proxy, cell, &smrproxy_return);
+    if (epoch == 0)
+    {
+        atomic_fetch_sub_explicit(&returns->pending, 1, memory_order_relaxed);
+        cell->next = returns->cells;
+        returns->cells = cell;
+    }
+    return epoch;
+}
+
+unsigned int smrproxy_ref_drain(smrproxy_ref_t *ref)
+{
+    smrproxy_returns_t *returns = ((smrproxy_ref_ex_t *) ref)->returns;
+    if (returns == NULL || atomic_load_explicit(&returns->head, memory_order_relaxed) == NULL)
+        return 0;
+
+    unsigned int count = 0;
+    smrproxy_return_t *cell = atomic_exchange_explicit(&returns->head, NULL, memory_order_acquire);
+    while (cell != NULL)
+    {
+        smrproxy_return_t *next = cell->next;
+        (cell->dtor)(cell->obj);
+        cell->next = returns->cells;
+        returns->cells = cell;
+        cell = next;
+        count++;
+    }
+    return count;
+}
+
 void smrproxy_ref_destroy(smrproxy_ref_t *ref)
 {
     smrproxy_ref_ex_destroy((smrproxy_ref_ex_t *) ref);
 }
 
+smrproxy_ref_t * smrproxy_ref_get(smrproxy_t *proxy)
+{
+    proxy = proxy->group;
+    mtx_lock(&proxy->mutex);
+    smrproxy_ref_ex_t *ref_ex = proxy->pool;
+    if (ref_ex != NULL)
+        proxy->pool = ref_ex->pool_next;
+    mtx_unlock(&proxy->mutex);
+
+    if (ref_ex == NULL)
+    {
+        ref_ex = smrproxy_ref_ex_alloc(proxy);
+        if (ref_ex == NULL)
+            return NULL;
+    }
+
+    ref_ex->pool_next = NULL;
+    return &ref_ex->ref;
+}
+
+void smrproxy_ref_put(smrproxy_ref_t *ref)
+{
+    smrproxy_ref_ex_t *ref_ex = (smrproxy_ref_ex_t *) ref;
+    smrproxy_t *proxy = ref_ex->proxy;
+
+    smrproxy_ref_release(ref);  // in case still acquired
+    smrproxy_ref_unhold(ref);
+    ref->data = 0;
+
+    mtx_lock(&proxy->mutex);
+    ref_ex->pool_next = proxy->pool;
+    proxy->pool = ref_ex;
+    mtx_unlock(&proxy->mutex);
+}
+
 static epoch_t poll_smrref(epoch_t oldest, smrproxy_ref_ex_t *ref)
 {
         epoch_t ref_epoch = ref->ref.epoch;
@@ -222,32 +586,220 @@ static epoch_t poll_smrref(epoch_t oldest, smrproxy_ref_ex_t *ref)
             return oldest;     
 }
 
+/**
+ * Add a reader reservation interval, growing interval arrays as needed.
+ * @param proxy
+ * @param lo interval lower bound
+ * @param hi interval upper bound or 0 if unbounded
+ * @returns true if added
+*/
+static bool ibr_add(smrproxy_t *proxy, epoch_t lo, epoch_t hi)
+{
+    if (proxy->ibr_count == proxy->ibr_size)
+    {
+        unsigned int size = proxy->ibr_size == 0 ? 16 : proxy->ibr_size * 2;
+        epoch_t *ibr_lo = realloc(proxy->ibr_lo, size * sizeof(epoch_t));
+        if (ibr_lo == NULL)
+            return false;
+        proxy->ibr_lo = ibr_lo;
+        epoch_t *ibr_hi = realloc(proxy->ibr_hi, size * sizeof(epoch_t));
+        if (ibr_hi == NULL)
+            return false;
+        proxy->ibr_hi = ibr_hi;
+        proxy->ibr_size = size;
+    }
+
+    proxy->ibr_lo[proxy->ibr_count] = lo;
+    proxy->ibr_hi[proxy->ibr_count] = hi;
+    proxy->ibr_count++;
+    return true;
+}
+
+/**
+ * Add a hazard pointer, growing hazard array as needed.
+ * @param proxy
+ * @param hazard
+ * @returns true if added
+*/
+static bool hazard_add(smrproxy_t *proxy, void *hazard)
+{
+    if (proxy->hazard_count == proxy->hazard_size)
+    {
+        unsigned int size = proxy->hazard_size == 0 ? 16 : proxy->hazard_size * 2;
+        void **hazards = realloc(proxy->hazards, size * sizeof(void *));
+        if (hazards == NULL)
+            return false;
+        proxy->hazards = hazards;
+        proxy->hazard_size = size;
+    }
+
+    proxy->hazards[proxy->hazard_count++] = hazard;
+    return true;
+}
+
+static bool is_hazard(smrproxy_t *proxy, void *obj)
+{
+    for (unsigned int ndx = 0; ndx < proxy->hazard_count; ndx++)
+    {
+        if (proxy->hazards[ndx] == obj)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Queue reclaim hook, keep hazard protected objects on held list.
+ * Every object is held if the hazard pointers weren't all collected.
+ * If no held list entry can be allocated the object is leaked rather than
+ * freed while still referenced.
+*/
+static bool smrproxy_hold(void *ctx, void *obj, void (*dtor)(void *))
+{
+    smrproxy_t *proxy = ctx;
+    void *target = dtor == &smrproxy_return ? ((smrproxy_return_t *) obj)->obj : obj;     // owned retire
+    if (!proxy->hazards_overflow && (proxy->hazard_count == 0 || !is_hazard(proxy, target)))
+        return false;
+
+    smrproxy_held_t *held = malloc(sizeof(smrproxy_held_t));
+    if (held != NULL)
+    {
+        held->obj = obj;
+        held->dtor = dtor;
+        held->next = proxy->held;
+        proxy->held = held;
+        proxy->stats.held++;
+    }
+    return true;
+}
+
+/**
+ * Reclaim held objects no longer protected by hazard pointers.
+*/
+static void smrproxy_reclaim_held(smrproxy_t *proxy)
+{
+    smrproxy_held_t **pprev = &proxy->held;
+    while (*pprev != NULL)
+    {
+        smrproxy_held_t *held = *pprev;
+        void *target = held->dtor == &smrproxy_return ? ((smrproxy_return_t *) held->obj)->obj : held->obj;
+        if (is_hazard(proxy, target))
+        {
+            pprev = &held->next;
+            continue;
+        }
+
+        *pprev = held->next;
+        (held->dtor)(held->obj);
+        free(held);
+        proxy->stats.held--;
+        proxy->stats.reclaimed++;
+    }
+}
+
+/**
+ * Publish current epoch to refs and compute oldest referenced epoch.
+ * Reservation intervals of refs in read sections are collected for
+ * interval based reclamation.  If they can't all be collected,
+ * ibr_count is set to UINT_MAX.  Hazard pointers are collected after
+ * the ref's epoch is read, if they can't all be collected hazards_overflow
+ * is set.
+*/
 static inline epoch_t update_effective_epochs(smrproxy_t *proxy, epoch_t effective)
 {
-    epoch_t current_epoch = *proxy->epoch;
+    epoch_t current_epoch = proxy_epoch(proxy);
     epoch_t oldest = current_epoch;     // should be same as current epoch / tail
+    unsigned int nrefs = 0;
+    bool ibr_ok = true;
+    bool hazard_ok = true;
+
+    proxy->ibr_count = 0;
+    proxy->hazard_count = 0;
 
     for (smrproxy_ref_ex_t *ref_ex = proxy->refs; ref_ex != NULL; ref_ex = ref_ex->next) {
-        atomic_store_explicit(&ref_ex->ref.current_epoch, current_epoch, memory_order_relaxed);
+        nrefs++;
+        smrproxy_ref_scan_t *scan = ref_ex->scan;
+#ifndef SMRPROXY_CLOCK
+        /*
+        * reader's line is only written when the epoch has changed, readers use clock otherwise
+        */
+        if (atomic_load_explicit(&ref_ex->ref.current_epoch, memory_order_relaxed) != current_epoch)
+            atomic_store_explicit(&ref_ex->ref.current_epoch, current_epoch, memory_order_relaxed);
+#endif
         epoch_t ref_epoch = atomic_load_explicit(&ref_ex->ref.epoch, memory_order_relaxed);
+
+        /*
+        * hazard set before epoch released by smrproxy_ref_hold
+        */
+        atomic_thread_fence(memory_order_acquire);
+        void *hazard = atomic_load_explicit(&ref_ex->ref.hazard, memory_order_relaxed);
+        if (hazard != NULL && hazard_ok)
+            hazard_ok = hazard_add(proxy, hazard);
+
         if (ref_epoch == 0)
-            ref_ex->ref.effective_epoch = effective;    // ? will always be >= previous value
-        else if (xcmp(ref_epoch,ref_ex->ref.effective_epoch) > 0)
-            ref_ex->ref.effective_epoch = ref_epoch;
+            scan->effective_epoch = effective;    // ? will always be >= previous value
+        else if (xcmp(ref_epoch, scan->effective_epoch) > 0)
+            scan->effective_epoch = ref_epoch;
 
-        epoch_t effective_epoch = ref_ex->ref.effective_epoch;
+        epoch_t effective_epoch = scan->effective_epoch;
+        SMR_TRACE(proxy, SMRTRACE_REF, ref_ex->id, ref_epoch, effective_epoch);
 
         if (xcmp(effective_epoch, proxy->head) < 0)
             continue;
         else if (xcmp(effective_epoch, oldest) < 0)
             oldest = effective_epoch;        
 
+        if (ref_epoch != 0 && ibr_ok)
+        {
+            epoch_t upper = atomic_load_explicit(&ref_ex->ref.upper, memory_order_relaxed);
+            ibr_ok = ibr_add(proxy, effective_epoch, upper);
+        }
     }
 
+    if (!ibr_ok)
+        proxy->ibr_count = UINT_MAX;
+
+    proxy->hazards_overflow = !hazard_ok;
+
+    SMR_PROBE3(scan, current_epoch, oldest, nrefs);
+    SMR_TRACE(proxy, SMRTRACE_SCAN, current_epoch, oldest, nrefs);
+
     return oldest;
 }
 
 
+/**
+ * Test if leader and member retire queues are all empty
+ * and no objects are held back by hazard pointers.
+*/
+static bool group_empty(smrproxy_t *proxy)
+{
+    if (!smrqueue_empty(proxy->queue) || proxy->held != NULL)
+        return false;
+
+    if (xcmp(proxy->gp_epoch, proxy->gp_head) >= 0)
+        return false;       // grace period cookie outstanding
+
+    for (smrproxy_t *member = proxy->members; member != NULL; member = member->member_next)
+    {
+        if (!smrqueue_empty(member->queue))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Test if any urgent lane has retired objects
+*/
+static bool urgent_pending(smrproxy_t *proxy)
+{
+    for (smrproxy_t *member = proxy->members; member != NULL; member = member->member_next)
+    {
+        if (member->priority == SMRPROXY_PRIORITY_URGENT && !smrqueue_empty(member->queue))
+            return true;
+    }
+    return false;
+}
+
 /**
  * Scan registered refs (hazard pointers) for oldest referenced epoch
  * Dequeue and deallocate any entries older than that.
@@ -259,34 +811,107 @@ static inline epoch_t update_effective_epochs(smrproxy_t *proxy, epoch_t effecti
  * 
 */
 static epoch_t smrproxy_poll(smrproxy_t *proxy) {
-    epoch_t epoch = *proxy->epoch;
-    if (epoch != proxy->sync_epoch)
+#ifndef SMRPROXY_CLOCK
+    if (proxy->lazy_epoch == *(proxy->epoch))
+        advance_epoch(proxy, proxy->lazy_epoch + 2);    // lazy retires since epoch last advanced
+#endif
+    epoch_t epoch = proxy_epoch(proxy);
+    bool percpu = smrpercpu_used(proxy->percpu);    // membarrier needed every poll once used
+    epoch_t percpu_oldest = epoch;
+#ifndef SMRPROXY_CLOCK
+    bool sync = epoch != proxy->sync_epoch;
+#else
+    bool sync = epoch != proxy->sync_epoch && !group_empty(proxy);     // clock keeps advancing while idle
+#endif
+    if (sync || percpu)
     {
         // update_effective_epochs(proxy, proxy->sync_epoch);          // premature optization
 
         proxy->sync_epoch = epoch;
+        SMR_PROBE1(membar_begin, epoch);
+        uint64_t t0 = smr_gettime();
         smrproxy_membar_sync(proxy->membar);
+        uint64_t membar_time = smr_gettime() - t0;
+        proxy->stats.membar_time += membar_time;
+        SMR_PROBE2(membar_end, epoch, membar_time);
+        SMR_TRACE(proxy, SMRTRACE_MEMBAR, epoch, membar_time, 0);
         /*
         * sync after other thread memory barriers
         * after call to smrproxy_membar_sync.
         */
         atomic_thread_fence(memory_order_seq_cst);
+
+        /*
+        * resample after the membarrier, a first per cpu reader may have
+        * started since the check above
+        */
+        percpu = smrpercpu_used(proxy->percpu);
+        if (percpu)
+            percpu_oldest = smrpercpu_poll(proxy->percpu, epoch);
     }
 
-    if (smrqueue_empty(proxy->queue))
+    if (group_empty(proxy))
         return epoch;
 
 
+    uint64_t t0 = smr_gettime();
     epoch_t oldest = update_effective_epochs(proxy, proxy->sync_epoch);;     // should be same as current epoch / tail
+    uint64_t scan_time = smr_gettime() - t0;
+    proxy->stats.scan_count++;
+    proxy->stats.scan_time += scan_time;
+    if (scan_time > proxy->stats.scan_time_max)
+        proxy->stats.scan_time_max = scan_time;
+
+    if (proxy->hazards_overflow)
+        return proxy->head;     // hazard pointers unknown, reclaim nothing
+
+    /*
+    * per cpu phase epochs from before first use may be older than head
+    */
+    if (xcmp(percpu_oldest, proxy->head) < 0)
+        percpu_oldest = proxy->head;
+    if (xcmp(percpu_oldest, oldest) < 0)
+        oldest = percpu_oldest;
+
+    smrproxy_reclaim_held(proxy);
+
+    epoch_t head = proxy->head;
+    unsigned int count = smr_dequeue(proxy->queue, oldest);
+    for (smrproxy_t *member = proxy->members; member != NULL; member = member->member_next)
+        count += smr_dequeue(member->queue, oldest);
+    if (xcmp(oldest, head) > 0)
+        atomic_store_explicit(&proxy->head, oldest, memory_order_release);
+    if (count > 0)
+        SMR_TRACE(proxy, SMRTRACE_RECLAIM, head, proxy->head, count);
+
+    /*
+    * a hazard pointer may be to an object parked with a gp cookie,
+    * cookies don't expire until no hazard pointers are set
+    */
+    if (proxy->hazard_count == 0 && !proxy->hazards_overflow)
+        atomic_store_explicit(&proxy->gp_head, proxy->head, memory_order_release);
+
+    /*
+    * entries past oldest retired before the last memory barrier
+    * whose lifetimes don't overlap any reader's interval
+    */
+    if (proxy->ibr_count != UINT_MAX)
+    {
+        epoch_t limit = xcmp(percpu_oldest, proxy->sync_epoch) < 0 ? percpu_oldest : proxy->sync_epoch;
+        smr_reclaim_intervals(proxy->queue, limit, proxy->ibr_lo, proxy->ibr_hi, proxy->ibr_count);
+        for (smrproxy_t *member = proxy->members; member != NULL; member = member->member_next)
+            smr_reclaim_intervals(member->queue, limit, proxy->ibr_lo, proxy->ibr_hi, proxy->ibr_count);
+    }
 
-    proxy->head = smr_dequeue(proxy->queue, oldest); // ?
     return proxy->head;
 }
 
 #define NANOS 1000000000
+#define URGENT_POLLTIME 1   // milliseconds
 static inline int poll_wait(smrproxy_t *proxy)
 {
-    unsigned long wait =  proxy->config.polltime * 1000000;  // milliseconds to nanoseconds
+    unsigned int polltime = urgent_pending(proxy) ? URGENT_POLLTIME : proxy->config.polltime;
+    unsigned long wait =  polltime * 1000000ul;  // milliseconds to nanoseconds
 
     struct timespec ts;
     timespec_get(&ts, TIME_UTC);
@@ -308,8 +933,13 @@ static epoch_t smrproxy_poll2(smrproxy_t *proxy, epoch_t epoch)
         if (epoch != 0 && xcmp(oldest, epoch) >= 0)
             return oldest;
 
-        if (smrqueue_empty(proxy->queue))
+        if (group_empty(proxy))
+        {
             cnd_wait(&proxy->cvar, &proxy->mutex);
+            if (proxy->lazy_wake && proxy->active)
+                poll_wait(proxy);   // only lazy retires, poll on timer
+            proxy->lazy_wake = false;
+        }
         else
             poll_wait(proxy);
 
@@ -328,38 +958,189 @@ static int *smrproxy_poll3(void *arg)
     return 0;
 }
 
-epoch_t smrproxy_retire_exp(smrproxy_t *proxy, void *data, void (*dtor)(void *), void (*setexpiry)(epoch_t expiry, void *data, void *ctx), void *ctx)
+static epoch_t smrproxy_retire_internal(smrproxy_t *proxy, void *data, void (*dtor)(void *), void (*setexpiry)(epoch_t expiry, void *data, void *ctx), void *ctx, epoch_t birth)
 {
-    mtx_lock(&proxy->mutex);
+    smrproxy_t *group = proxy->group;
+    mtx_lock(&group->mutex);
 
     if (smrqueue_full(proxy->queue))
     {
-        mtx_unlock(&proxy->mutex);
+        mtx_unlock(&group->mutex);
         return 0;
     }
 
+    bool lazy = proxy->priority == SMRPROXY_PRIORITY_LAZY;
+    bool idle = lazy && group_empty(group);
+
+#ifndef SMRPROXY_CLOCK
+    epoch_t expiry = *(group->epoch);
+#else
+    /*
+    * object unpublished before clock is read, a reader
+    * with a later clock epoch can't see it
+    */
+    atomic_thread_fence(memory_order_seq_cst);
+    epoch_t expiry = smrproxy_clock_epoch();
+#endif
     if (setexpiry != NULL)
     {
-        epoch_t expiry = *(proxy->epoch);
         (*setexpiry)(expiry, data, ctx);
         // store/store membar below from proxy->epoch update
     }
 
-    epoch_t epoch = smr_enqueue(proxy->queue, data, dtor);
-    atomic_store_explicit(proxy->epoch, epoch, memory_order_release);
+    smr_enqueue(proxy->queue, data, dtor, birth, expiry);
+    epoch_t epoch = expiry + 2;
+#ifndef SMRPROXY_CLOCK
+    if (lazy)
+        group->lazy_epoch = expiry;     // next poll advances epoch
+    else
+        advance_epoch(group, epoch);
+#endif
 
-    cnd_broadcast(&proxy->cvar);
+    SMR_PROBE3(retire, expiry, epoch, (epoch - group->head) / 2);
+    SMR_TRACE(group, SMRTRACE_RETIRE, expiry, birth, (epoch - group->head) / 2);
 
-    mtx_unlock(&proxy->mutex);
+    if (!lazy)
+    {
+        group->lazy_wake = false;
+        cnd_broadcast(&group->cvar);
+    }
+    else if (idle)
+    {
+        group->lazy_wake = true;
+        cnd_broadcast(&group->cvar);    // poll thread off timer while queues empty
+    }
+
+    mtx_unlock(&group->mutex);
     return epoch;
 }
 
+epoch_t smrproxy_retire_exp(smrproxy_t *proxy, void *data, void (*dtor)(void *), void (*setexpiry)(epoch_t expiry, void *data, void *ctx), void *ctx)
+{
+    return smrproxy_retire_internal(proxy, data, dtor, setexpiry, ctx, 0);
+}
+
+epoch_t smrproxy_retire_birth(smrproxy_t *proxy, void *data, void (*dtor)(void *), epoch_t birth)
+{
+    return smrproxy_retire_internal(proxy, data, dtor, NULL, NULL, birth);
+}
 
 epoch_t smrproxy_retire(smrproxy_t *proxy, void *data, void (*dtor)(void *))
 {
     return smrproxy_retire_exp(proxy, data, dtor, NULL, NULL);
 }
 
+/**
+ * Get proxy's retire lane for priority, creating it on first use.
+ * @returns the lane or NULL if no memory
+*/
+static smrproxy_t * get_lane(smrproxy_t *proxy, int priority)
+{
+    smrproxy_t *group = proxy->group;
+    mtx_lock(&group->mutex);
+    smrproxy_t *lane = proxy->lanes[priority - 1];
+    mtx_unlock(&group->mutex);
+    if (lane != NULL)
+        return lane;
+
+    smrproxy_t *new_lane = smrproxy_create_member(group, &proxy->config);
+    if (new_lane == NULL)
+        return NULL;
+
+    mtx_lock(&group->mutex);
+    lane = proxy->lanes[priority - 1];
+    if (lane == NULL)
+    {
+        new_lane->priority = priority;
+        smrqueue_copy_batch(new_lane->queue, proxy->queue);
+        proxy->lanes[priority - 1] = new_lane;
+        lane = new_lane;
+        new_lane = NULL;
+    }
+    mtx_unlock(&group->mutex);
+
+    if (new_lane != NULL)
+        smrproxy_member_destroy(new_lane);      // lost race, empty
+    return lane;
+}
+
+epoch_t smrproxy_retire_priority(smrproxy_t *proxy, void *data, void (*dtor)(void *), int priority)
+{
+    if (priority != SMRPROXY_PRIORITY_URGENT && priority != SMRPROXY_PRIORITY_LAZY)
+        return smrproxy_retire(proxy, data, dtor);
+
+    smrproxy_t *lane = get_lane(proxy, priority);
+    if (lane == NULL)
+        return 0;
+    return smrproxy_retire(lane, data, dtor);
+}
+
+smrproxy_gp_cookie_t smrproxy_gp_start(smrproxy_t *proxy)
+{
+    smrproxy_t *group = proxy->group;
+    mtx_lock(&group->mutex);
+
+#ifndef SMRPROXY_CLOCK
+    epoch_t expiry = *(group->epoch);
+    advance_epoch(group, expiry + 2);
+#else
+    atomic_thread_fence(memory_order_seq_cst);
+    epoch_t expiry = smrproxy_clock_epoch();
+#endif
+    group->gp_epoch = expiry;
+
+    cnd_broadcast(&group->cvar);    // poll thread may be waiting on an empty queue
+
+    mtx_unlock(&group->mutex);
+    return expiry;
+}
+
+bool smrproxy_gp_done(smrproxy_t *proxy, smrproxy_gp_cookie_t cookie)
+{
+    return xcmp(cookie, atomic_load_explicit(&proxy->group->gp_head, memory_order_acquire)) < 0;
+}
+
+int smrproxy_wait_epoch(smrproxy_t *proxy, epoch_t seen, const struct timespec *abstime)
+{
+    smrproxy_t *group = proxy->group;
+    int rc = thrd_success;
+
+#ifndef SMRPROXY_CLOCK
+    atomic_fetch_add_explicit(&group->epoch_waiters, 1, memory_order_seq_cst);
+
+    while (atomic_load_explicit(group->epoch, memory_order_seq_cst) == seen)
+    {
+        rc = smr_futex_wait(group->epoch, seen, abstime);
+        if (rc != thrd_success)
+            break;
+    }
+
+    atomic_fetch_sub_explicit(&group->epoch_waiters, 1, memory_order_relaxed);
+#else
+    /*
+    * clock epochs advance on their own, not on retire, wait a clock tick
+    */
+    struct timespec tick = { 0, 1l << SMRPROXY_CLOCK_SHIFT };
+    while (smrproxy_clock_epoch() == seen)
+    {
+        if (abstime != NULL)
+        {
+            struct timespec now;
+            timespec_get(&now, TIME_UTC);
+            if (now.tv_sec > abstime->tv_sec || (now.tv_sec == abstime->tv_sec && now.tv_nsec >= abstime->tv_nsec))
+            {
+                rc = thrd_timedout;
+                break;
+            }
+        }
+        thrd_sleep(&tick, NULL);
+    }
+    (void) group;
+#endif
+
+    return rc;
+}
+
 /**
  * get current epoch
  * @param proxy
@@ -367,7 +1148,79 @@ epoch_t smrproxy_retire(smrproxy_t *proxy, void *data, void (*dtor)(void *))
 */
 epoch_t smrproxy_get_epoch(smrproxy_t *proxy)
 {
-    return atomic_load_explicit(proxy->epoch, memory_order_acquire);
+    return proxy_epoch(proxy);
+}
+
+int smrproxy_register_batch(smrproxy_t *proxy, void (*dtor)(void *), void (*batch)(void **objs, unsigned int count))
+{
+    mtx_lock(&proxy->group->mutex);
+    int rc = smrqueue_register_batch(proxy->queue, dtor, batch);
+    for (int ndx = 0; ndx < SMRPROXY_LANES; ndx++)
+    {
+        if (rc == 0 && proxy->lanes[ndx] != NULL)
+            rc = smrqueue_register_batch(proxy->lanes[ndx]->queue, dtor, batch);
+    }
+    mtx_unlock(&proxy->group->mutex);
+    return rc;
+}
+
+void smrproxy_free_batch(void **objs, unsigned int count)
+{
+    for (unsigned int ndx = 0; ndx < count; ndx++)
+    {
+        if (ndx + 2 < count)
+            __builtin_prefetch(objs[ndx + 2], 1, 0);    // allocator chunk header is just before object
+        free(objs[ndx]);
+    }
+}
+
+/**
+ * get birth epoch for a new object
+ * @param proxy
+ * @returns the current epoch
+*/
+epoch_t smrproxy_birth_epoch(smrproxy_t *proxy)
+{
+    return proxy_epoch(proxy);
+}
+
+void smrproxy_get_stats(smrproxy_t *proxy, smrproxy_stats_t *stats)
+{
+    smrproxy_t *group = proxy->group;
+    mtx_lock(&group->mutex);
+    *stats = group->stats;                          // group members share poll thread stats
+    smrqueue_stats(proxy->queue, stats);
+    for (int ndx = 0; ndx < SMRPROXY_LANES; ndx++)
+    {
+        if (proxy->lanes[ndx] == NULL)
+            continue;
+        smrproxy_stats_t lane_stats;
+        smrqueue_stats(proxy->lanes[ndx]->queue, &lane_stats);
+        stats->retired += lane_stats.retired;
+        stats->reclaimed += lane_stats.reclaimed;
+        stats->queue_depth += lane_stats.queue_depth;
+        for (int bucket = 0; bucket < SMRPROXY_HIST_SIZE; bucket++)
+            stats->latency[bucket] += lane_stats.latency[bucket];
+    }
+    if (proxy == group)
+        stats->reclaimed += group->stats.reclaimed; // held objects reclaimed
+    stats->epoch_lag = proxy_epoch(group) - group->head;
+    stats->membar_count = smrproxy_membar_count(group->membar);
+    mtx_unlock(&group->mutex);
+}
+
+/**
+ * get number of global memory barriers executed
+ * @param proxy
+ * @returns membarrier count
+*/
+unsigned long smrproxy_get_membar_count(smrproxy_t *proxy)
+{
+    proxy = proxy->group;
+    mtx_lock(&proxy->mutex);
+    unsigned long count = smrproxy_membar_count(proxy->membar);
+    mtx_unlock(&proxy->mutex);
+    return count;
 }
 
 /**
@@ -393,7 +1246,11 @@ void smrproxy_ref_next(smrproxy_ref_t *ref, epoch_t (*getexpiry)(void *node, voi
         return;
     }
 
+#ifndef SMRPROXY_CLOCK
     epoch_t current_epoch = atomic_load_explicit(ref->proxy_epoch, memory_order_acquire);
+#else
+    epoch_t current_epoch = smrproxy_clock_epoch();
+#endif
     // should be a load/load memory barrier here from the above memory_order_acquire
     epoch_t node_expiry = (*getexpiry)(node, ctx);
 
@@ -57,19 +57,77 @@ inline static cc_epoch_t xcmp(epoch_t a, epoch_t b) { return (a - b); }
 
 typedef struct smrqueue_t smrqueue_t;
 
+/*
+* queue reclaim hook, returns true if it takes over obj
+*/
+typedef bool (*smrqueue_hold_t)(void *ctx, void *obj, void (*dtor)(void *));
+
+/*
+* retired object held back by a hazard pointer
+*/
+typedef struct smrproxy_held_t {
+    struct smrproxy_held_t *next;
+    void *obj;
+    void (*dtor)(void *);
+} smrproxy_held_t;
+
 typedef struct smrproxy_membar_t smrproxy_membar_t;
 
+typedef struct smrtrace_t smrtrace_t;
+
+typedef struct smrproxy_percpu_t smrproxy_percpu_t;
+
+typedef struct smrregion_cache_t smrregion_cache_t;
+
+
+/*
+* reclaimer owned ref state, on its own cache line so scans
+* don't invalidate the reader's line
+*/
+typedef struct smrproxy_ref_scan_t {
+    epoch_t effective_epoch;        // effective epoch as observed by reclaim thread, never 0
+} smrproxy_ref_scan_t;
+
+/*
+* object reclaimed on behalf of a ref's owner, returned to the owner to free
+*/
+typedef struct smrproxy_return_t {
+    struct smrproxy_return_t *next;
+    void *obj;
+    void (*dtor)(void *);
+    struct smrproxy_returns_t *returns;
+} smrproxy_return_t;
+
+/*
+* ref owner's return list.  The poll thread pushes reclaimed objects,
+* the owner drains them.  pending and orphaned are changed under proxy
+* mutex, except the owner increments pending before retiring.
+*/
+typedef struct smrproxy_returns_t {
+    _Atomic(smrproxy_return_t *) head;
+    atomic_uint pending;            // retired, not yet returned
+    bool orphaned;                  // ref destroyed, free objects on poll thread
+    smrproxy_return_t *cells;       // drained cells for reuse, owner only
+} smrproxy_returns_t;
 
 typedef struct smrproxy_ref_ex_t {
     smrproxy_ref_t ref;
 
+    smrproxy_ref_scan_t *scan;      // cache line following ref_ex in same memory block
+    smrproxy_returns_t *returns;    // owner affine reclamation, NULL until first used
+
     smrproxy_t *proxy;
     struct smrproxy_ref_ex_t *next;
+    struct smrproxy_ref_ex_t *pool_next;    // next free task ref in proxy pool
+
+    unsigned int id;    // ref id for trace records
 
     void *base;         // address of allocated memory block containing this struct
     size_t size;        // size of allocated memory block;
 } smrproxy_ref_ex_t;
 
+#define SMRPROXY_LANES 2    // urgent and lazy retire lanes
+
 /*
 * smrproxy
 *
@@ -79,9 +137,12 @@ typedef struct smrproxy_ref_ex_t {
 *
 */
 typedef struct smrproxy_t {
-    epoch_t *epoch;          // current epoch, a.k.a tail
+    epoch_t *epoch;          // current epoch, a.k.a tail, shared by group members
+
+    _Atomic(epoch_t) head;  // oldest
 
-    epoch_t head;           // oldest
+    epoch_t gp_epoch;       // latest smrproxy_gp_start cookie
+    _Atomic(epoch_t) gp_head;   // head as of last poll without hazard pointers, read by smrproxy_gp_done
 
     epoch_t sync_epoch;     // last memorybarrier synced epoch
 
@@ -99,10 +160,60 @@ typedef struct smrproxy_t {
     */
     smrproxy_ref_ex_t *refs;
 
+    /*
+    * free task owned refs, still registered
+    */
+    smrproxy_ref_ex_t *pool;
+
     smrqueue_t *queue;
 
+    /*
+    * epoch clock group.  Members share the leader's epoch, mutex, refs
+    * and poll thread, and have their own retire queue.
+    */
+    struct smrproxy_t *group;       // group leader, self if not a member
+    struct smrproxy_t *members;     // leader only
+    struct smrproxy_t *member_next;
+
+    /*
+    * retire priority lanes, internal group members with their own
+    * queue, created on first use
+    */
+    struct smrproxy_t *lanes[SMRPROXY_LANES];    // urgent and lazy lanes
+    int priority;                   // lane priority, SMRPROXY_PRIORITY_NORMAL if not a lane
+    epoch_t lazy_epoch;             // leader only, expiry of latest lazy retire, epoch not yet advanced
+    bool lazy_wake;                 // leader only, idle poll thread woken by lazy retire waits for its timer
+
+    atomic_uint epoch_waiters;      // leader only, threads in smrproxy_wait_epoch
+
+    /*
+    * reader reservation intervals collected by poll, IBR
+    */
+    epoch_t *ibr_lo;
+    epoch_t *ibr_hi;
+    unsigned int ibr_count;
+    unsigned int ibr_size;
+
+    /*
+    * hazard pointers collected by poll and objects they hold back
+    */
+    void **hazards;
+    unsigned int hazard_count;
+    unsigned int hazard_size;
+    bool hazards_overflow;          // not all hazard pointers collected, hold every reclaimed object
+    smrproxy_held_t *held;
+
     smrproxy_config_t config;
 
+    smrproxy_stats_t stats;         // poll thread stats, queue stats are kept in queue
+
+    smrproxy_percpu_t *percpu;      // per cpu readers
+
+    smrregion_cache_t *regions;     // retired region cache, NULL until first used
+
+    smrtrace_t *trace;              // trace recorder or NULL
+    unsigned int ref_ids;           // last ref id assigned
+
     atomic_bool active;
 } smrproxy_t;
 
@@ -111,25 +222,81 @@ typedef struct smrproxy_t {
 * internal
 */
 
-extern smrqueue_t *smrqueue_create(epoch_t epoch, unsigned int size);
+extern smrqueue_t *smrqueue_create(unsigned int size);
 extern void smrqueue_destroy(smrqueue_t *queue);
 extern bool smrqueue_empty(smrqueue_t *queue);
 extern bool smrqueue_full(smrqueue_t *queue);
-extern epoch_t smr_enqueue(smrqueue_t *queue, void *obj, void (*dtor)(void *));
-extern epoch_t smr_dequeue(smrqueue_t *queue, const epoch_t oldest);
+extern bool smr_enqueue(smrqueue_t *queue, void *obj, void (*dtor)(void *), epoch_t birth, epoch_t expiry);
+extern unsigned int smr_dequeue(smrqueue_t *queue, const epoch_t oldest);
+extern unsigned int smr_reclaim_intervals(smrqueue_t *queue, const epoch_t limit, const epoch_t *lo, const epoch_t *hi, unsigned int count);
+extern void smrqueue_stats(smrqueue_t *queue, smrproxy_stats_t *stats);
+extern void smrqueue_set_hold(smrqueue_t *queue, smrqueue_hold_t hold, void *ctx);
+extern int smrqueue_register_batch(smrqueue_t *queue, void (*dtor)(void *), void (*batch)(void **objs, unsigned int count));
+extern int smrqueue_copy_batch(smrqueue_t *queue, smrqueue_t *from);
 
 /*
 * get cache line size
 */
 extern long getcachesize();
 
+/*
+* get time in nanoseconds
+*/
+extern uint64_t smr_gettime();
+
+/*
+* get current cpu and number of cpus
+*/
+extern unsigned int smr_getcpu();
+extern unsigned int smr_getncpu();
+
+/*
+* per cpu readers
+*/
+extern smrproxy_percpu_t *smrpercpu_create(epoch_t epoch, long cachesize);
+extern void smrpercpu_destroy(smrproxy_percpu_t *percpu);
+extern bool smrpercpu_used(smrproxy_percpu_t *percpu);
+extern epoch_t smrpercpu_poll(smrproxy_percpu_t *percpu, epoch_t sync_epoch);
+
+/*
+* map file of given size, shared, read/write, created or truncated
+*/
+extern void *smr_map_file(const char *path, size_t size);
+extern void smr_unmap_file(void *addr, size_t size);
+
+/*
+* anonymous memory regions, map, unmap and discard pages
+*/
+extern void *smr_map_region(size_t size);
+extern void smr_unmap_region(void *addr, size_t size);
+extern void smr_discard_region(void *addr, size_t size);
+
+/*
+* retired region cache
+*/
+extern void smrregion_cache_destroy(smrregion_cache_t *cache);
+
+/*
+* trace recorder
+*/
+extern void smrtrace_record(smrtrace_t *trace, unsigned int type, uint32_t a, uint32_t b, uint32_t c);
+
 /*
  * memorybarrier
 */
 
 extern smrproxy_membar_t *smrproxy_membar_create();
+extern smrproxy_membar_t *smrproxy_membar_create_global();
 extern void smrproxy_membar_destroy(smrproxy_membar_t * membar);
 extern void smrproxy_membar_sync(smrproxy_membar_t * membar);
+extern unsigned long smrproxy_membar_count(smrproxy_membar_t * membar);
+
+/*
+ * futex
+*/
+
+extern int smr_futex_wait(uint32_t *addr, uint32_t val, const struct timespec *abstime);
+extern void smr_futex_wake(uint32_t *addr);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,63 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+   
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef SMRPROXY_TRACE_H
+#define SMRPROXY_TRACE_H
+
+/*
+* USDT static tracepoints, provider smrproxy
+*
+*   retire(expiry, epoch, depth)            smrproxy_retire_exp
+*   membar_begin(epoch)                     smrproxy_poll, before smrproxy_membar_sync
+*   membar_end(epoch, nanos)                smrproxy_poll, after smrproxy_membar_sync
+*   scan(current, oldest, refs)             update_effective_epochs
+*   reclaim(head, oldest, count, nanos)     smr_dequeue
+*   ref_create(ref, proxy)
+*   ref_destroy(ref, proxy)
+*
+* Enabled by defining SMRPROXY_USDT, which the build does when sys/sdt.h
+* is available.  A disabled probe site is a single nop.
+*
+* e.g. bpftrace -e 'usdt:./app:smrproxy:membar_end { @ns = hist(arg1); }'
+*/
+
+#ifdef SMRPROXY_USDT
+#include <sys/sdt.h>
+
+#define SMR_PROBE1(name, a)             DTRACE_PROBE1(smrproxy, name, a)
+#define SMR_PROBE2(name, a, b)          DTRACE_PROBE2(smrproxy, name, a, b)
+#define SMR_PROBE3(name, a, b, c)       DTRACE_PROBE3(smrproxy, name, a, b, c)
+#define SMR_PROBE4(name, a, b, c, d)    DTRACE_PROBE4(smrproxy, name, a, b, c, d)
+
+#else
+
+#define SMR_PROBE1(name, a)
+#define SMR_PROBE2(name, a, b)
+#define SMR_PROBE3(name, a, b, c)
+#define SMR_PROBE4(name, a, b, c, d)
+
+#endif
+
+/*
+* trace recorder, smrtrace.h, proxy mutex must be held
+*/
+#define SMR_TRACE(proxy, type, a, b, c) \
+    do { \
+        if ((proxy)->trace != NULL) \
+            smrtrace_record((proxy)->trace, type, a, b, c); \
+    } while (0)
+
+#endif /* SMRPROXY_TRACE_H */
@@ -20,6 +20,7 @@
 //#include <stdatomic.h>
 //#include <threads.h>
 #include <smrproxy_intr.h>
+#include <smrproxy_trace.h>
 
 #include <stdio.h>
 
@@ -30,26 +31,49 @@
 typedef struct {
     void *obj;                  // data object being retired
     void (*dtor)(void *);       // retirement function, e.g. free, dtor, ...
+    uint64_t time;              // retire time in nanoseconds
+    epoch_t expiry;             // expiry epoch
+    epoch_t birth;              // birth epoch or 0 if unknown
 } node_t;
 
 
+/*
+* batch dtor and its pending objects
+*/
+typedef struct {
+    void (*dtor)(void *);
+    void (*batch)(void **objs, unsigned int count);
+    unsigned int count;
+    void **objs;                // SMRQUEUE_BATCH_SIZE objects
+} batch_t;
+
+#define SMRQUEUE_BATCH_SIZE 256
+
 typedef struct smrqueue_t {
     unsigned int size;
-    epoch_t max_epoch;
 
     unsigned int head_ndx;
     unsigned int tail_ndx;
+    unsigned int count;         // queued entries, holes included
+
+    unsigned int births;        // queued entries with birth epochs
+    unsigned int holes;         // entries already reclaimed out of order
+
+    smrqueue_hold_t hold;       // optional reclaim hook
+    void *hold_ctx;
+
+    unsigned int nbatch;        // registered batch dtors
+    batch_t batch[SMRPROXY_MAX_BATCH];
+
+    unsigned long retired;
+    unsigned long reclaimed;
+    unsigned long latency[SMRPROXY_HIST_SIZE];     // retire to reclaim latency histogram
 
-    epoch_t head;
-    epoch_t tail;
     node_t node[];
 } smrqueue_t;
 
-smrqueue_t *smrqueue_create(epoch_t epoch, unsigned int size)
+smrqueue_t *smrqueue_create(unsigned int size)
 {
-    if ((epoch & 1) != 1)
-        return NULL;            // starting epoch must be odd number
-
     // TODO  size < EPOCH_MAX / 4
 
     int sz = sizeof(smrqueue_t)  + (size * sizeof(node_t));
@@ -59,26 +83,26 @@ smrqueue_t *smrqueue_create(epoch_t epoch, unsigned int size)
 
     queue->head_ndx = 0;
     queue->tail_ndx = 0;
-
-    queue->head = epoch;
-    queue->tail = epoch;
+    queue->count = 0;
 
     return queue;
 }
 
 void smrqueue_destroy(smrqueue_t *queue)
 {
+    for (unsigned int ndx = 0; ndx < queue->nbatch; ndx++)
+        free(queue->batch[ndx].objs);
     free(queue);
 }
 
 bool smrqueue_empty(smrqueue_t *queue)
 {
-    return queue->tail == queue->head;
+    return queue->count == 0;
 }
 
 bool smrqueue_full(smrqueue_t *queue)
 {
-    return (queue->tail - queue->head) == queue->size;
+    return queue->count == queue->size;
 }
 
 
@@ -89,52 +113,281 @@ bool smrqueue_full(smrqueue_t *queue)
  * @param queue
  * @param obj
  * @param dtor
+ * @param birth birth epoch of obj or 0 if unknown
+ * @param expiry expiry epoch of obj, non-decreasing from one enqueue to the next
  * 
- * @returns new/update epoch or 0 if queue full
+ * @returns true or false if queue full
 */
-epoch_t smr_enqueue(smrqueue_t *queue, void *obj, void (*dtor)(void *))
+bool smr_enqueue(smrqueue_t *queue, void *obj, void (*dtor)(void *), epoch_t birth, epoch_t expiry)
 {
     if (smrqueue_full(queue))
-        return 0;
+        return false;
 
     node_t *node = &queue->node[queue->tail_ndx];
 
     node->obj = obj;
     node->dtor = dtor;
+    node->time = smr_gettime();
+    node->expiry = expiry;
+    node->birth = birth;
+
+    if (birth != 0)
+        queue->births++;
+    queue->retired++;
 
     queue->tail_ndx = (queue->tail_ndx + 1) % queue->size;
-    queue->tail += 2;
+    queue->count++;
+
+    return true;
+}
+
+/**
+ * Set reclaim hook.  The hook is called for each entry about to be
+ * reclaimed and returns true if it has taken over the entry, in which
+ * case the entry's dtor is not called by the queue.
+ *
+ * @param queue
+ * @param hold hook or NULL
+ * @param ctx hook context
+*/
+void smrqueue_set_hold(smrqueue_t *queue, smrqueue_hold_t hold, void *ctx)
+{
+    queue->hold = hold;
+    queue->hold_ctx = ctx;
+}
+
+/**
+ * Register a batch dtor.  Reclaimed objects with dtor are collected
+ * and passed to batch as an array, once per reclaim pass or whenever
+ * SMRQUEUE_BATCH_SIZE objects have been collected.
+ *
+ * @param queue
+ * @param dtor dtor used to retire objects
+ * @param batch batch dtor
+ * @returns 0 on success, -1 if too many batch dtors or no memory
+*/
+int smrqueue_register_batch(smrqueue_t *queue, void (*dtor)(void *), void (*batch)(void **objs, unsigned int count))
+{
+    for (unsigned int ndx = 0; ndx < queue->nbatch; ndx++)
+    {
+        if (queue->batch[ndx].dtor == dtor)
+        {
+            queue->batch[ndx].batch = batch;
+            return 0;
+        }
+    }
+
+    if (queue->nbatch == SMRPROXY_MAX_BATCH)
+        return -1;
+
+    void **objs = malloc(SMRQUEUE_BATCH_SIZE * sizeof(void *));
+    if (objs == NULL)
+        return -1;
+
+    batch_t *entry = &queue->batch[queue->nbatch];
+    entry->dtor = dtor;
+    entry->batch = batch;
+    entry->count = 0;
+    entry->objs = objs;
+    queue->nbatch++;
+    return 0;
+}
+
+/**
+ * Register another queue's batch dtors.
+ * @param queue the queue
+ * @param from queue to copy batch dtors from
+ * @returns 0 on success, -1 if too many batch dtors or no memory
+*/
+int smrqueue_copy_batch(smrqueue_t *queue, smrqueue_t *from)
+{
+    for (unsigned int ndx = 0; ndx < from->nbatch; ndx++)
+    {
+        if (smrqueue_register_batch(queue, from->batch[ndx].dtor, from->batch[ndx].batch) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static inline void flush_batch(batch_t *entry)
+{
+    if (entry->count != 0)
+    {
+        (entry->batch)(entry->objs, entry->count);
+        entry->count = 0;
+    }
+}
+
+/*
+* end of reclaim pass
+*/
+static void flush_batches(smrqueue_t *queue)
+{
+    for (unsigned int ndx = 0; ndx < queue->nbatch; ndx++)
+        flush_batch(&queue->batch[ndx]);
+}
+
+/*
+* call dtor, or add to dtor's batch, and record stats, node becomes a hole
+*/
+static void reclaim_node(smrqueue_t *queue, node_t *node, uint64_t now)
+{
+    if (node->birth != 0)
+        queue->births--;
 
-    return queue->tail;
+    if (queue->hold != NULL && (queue->hold)(queue->hold_ctx, node->obj, node->dtor))
+    {
+        node->obj = NULL;
+        node->dtor = NULL;
+        return;
+    }
+
+    uint64_t latency = now > node->time ? now - node->time : 1;
+    unsigned int bucket = 63 - __builtin_clzll(latency);
+    if (bucket >= SMRPROXY_HIST_SIZE)
+        bucket = SMRPROXY_HIST_SIZE - 1;
+    queue->latency[bucket]++;
+    queue->reclaimed++;
+
+    batch_t *entry = NULL;
+    for (unsigned int ndx = 0; ndx < queue->nbatch; ndx++)
+    {
+        if (queue->batch[ndx].dtor == node->dtor)
+        {
+            entry = &queue->batch[ndx];
+            break;
+        }
+    }
+
+    if (entry != NULL)
+    {
+        entry->objs[entry->count++] = node->obj;
+        if (entry->count == SMRQUEUE_BATCH_SIZE)
+            flush_batch(entry);
+    }
+    else
+        (node->dtor)(node->obj);
+
+    node->obj = NULL;
+    node->dtor = NULL;
 }
 
 /**
  * Dequeue and deallocate unreferenced retired entries.
  * 
- * Entries in includsive/exclusive range [head, oldest)
- * are dequeued and deallocated
+ * Entries with expiry epochs before oldest are dequeued and deallocated
  * 
  * @note queue is not lock-free, proxy mutex must be held
  * 
  * @param queue
  * @param oldest referenced epoch
  * 
- * @returns new value of queue head
+ * @returns number of entries dequeued
 *
 */
-epoch_t smr_dequeue(smrqueue_t *queue, const epoch_t oldest)
+unsigned int smr_dequeue(smrqueue_t *queue, const epoch_t oldest)
 {
-    if (xcmp(oldest, queue->head) <= 0)
-        return queue->head;
+    if (queue->count == 0 || xcmp(queue->node[queue->head_ndx].expiry, oldest) >= 0)
+        return 0;
+
+    uint64_t now = smr_gettime();
+    epoch_t head = queue->node[queue->head_ndx].expiry;
+    (void) head;        // probe only
+    unsigned int count = 0;
 
-    for (epoch_t epoch_ndx = queue->head; epoch_ndx != oldest; epoch_ndx += 2)
+    while (queue->count > 0)
     {
         node_t  *node = &queue->node[queue->head_ndx];
-        (node->dtor)(node->obj);
-        node->obj = NULL;
-        node->dtor = NULL;
+        if (xcmp(node->expiry, oldest) >= 0)
+            break;
+
+        if (node->dtor != NULL)
+            reclaim_node(queue, node, now);
+        else
+            queue->holes--;
+
         queue->head_ndx = (queue->head_ndx + 1) % queue->size;
+        queue->count--;
+        count++;
+    }
+
+    flush_batches(queue);
+
+    SMR_PROBE4(reclaim, head, oldest, count, smr_gettime() - now);
+
+    return count;
+}
+
+/**
+ * Reclaim retired entries out of order using their birth epochs.
+ *
+ * An entry with birth epoch b and expiry epoch x is reclaimed if no reader
+ * reservation interval [lo, hi] overlaps [b, x].  Reclaimed entries
+ * become holes which keep their queue slot until smr_dequeue passes them.
+ *
+ * @note proxy mutex must be held
+ *
+ * @param queue
+ * @param limit only entries with expiry epochs before limit are considered
+ * @param lo reservation interval lower bounds
+ * @param hi reservation interval upper bounds, 0 is unbounded
+ * @param count number of reservation intervals
+ *
+ * @returns number of entries reclaimed
+*/
+unsigned int smr_reclaim_intervals(smrqueue_t *queue, const epoch_t limit, const epoch_t *lo, const epoch_t *hi, unsigned int count)
+{
+    if (queue->births == 0)
+        return 0;
+
+    uint64_t now = smr_gettime();
+    unsigned int reclaimed = 0;
+    unsigned int ndx = queue->head_ndx;
+
+    for (unsigned int n = 0; n < queue->count; n++)
+    {
+        node_t *node = &queue->node[ndx];
+        ndx = (ndx + 1) % queue->size;
+
+        epoch_t expiry = node->expiry;
+        if (xcmp(expiry, limit) >= 0)
+            break;
+
+        if (node->dtor == NULL || node->birth == 0)
+            continue;
+
+        bool reserved = false;
+        for (unsigned int rndx = 0; rndx < count && !reserved; rndx++)
+        {
+            reserved = xcmp(expiry, lo[rndx]) >= 0
+                && (hi[rndx] == 0 || xcmp(node->birth, hi[rndx]) <= 0);
+        }
+
+        if (!reserved)
+        {
+            reclaim_node(queue, node, now);
+            queue->holes++;
+            reclaimed++;
+        }
     }
-    queue->head = oldest;
-    return oldest;
-}
\ No newline at end of file
+
+    flush_batches(queue);
+
+    return reclaimed;
+}
+
+/**
+ * Get queue statistics
+ *
+ * @note proxy mutex must be held
+ *
+ * @param queue
+ * @param stats retired, reclaimed, queue_depth, and latency are set
+*/
+void smrqueue_stats(smrqueue_t *queue, smrproxy_stats_t *stats)
+{
+    stats->retired = queue->retired;
+    stats->reclaimed = queue->reclaimed;
+    stats->queue_depth = queue->count - queue->holes;
+    memcpy(stats->latency, queue->latency, sizeof(stats->latency));
+}
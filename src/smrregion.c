@@ -0,0 +1,253 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <threads.h>
+#include <string.h>
+
+#include <smrproxy_intr.h>
+
+/*
+* retired region, also the warm cache list node
+*/
+typedef struct smrregion_t {
+    struct smrregion_t *next;
+    char *addr;
+    size_t size;
+    int flags;
+    smrregion_cache_t *cache;
+} smrregion_t;
+
+/*
+* per proxy warm cache of unmap regions, reclaim pass adds,
+* smrproxy_region_alloc takes
+*/
+typedef struct smrregion_cache_t {
+    mtx_t mutex;
+    size_t max;                 // cache limit in bytes, 0 to not cache
+    size_t bytes;               // cached bytes
+    smrregion_t *regions;
+} smrregion_cache_t;
+
+static smrregion_cache_t * smrregion_cache_create()
+{
+    smrregion_cache_t *cache = malloc(sizeof(smrregion_cache_t));
+    if (cache == NULL)
+        return NULL;
+    mtx_init(&cache->mutex, mtx_plain);
+    cache->max = 0;
+    cache->bytes = 0;
+    cache->regions = NULL;
+    return cache;
+}
+
+void smrregion_cache_destroy(smrregion_cache_t *cache)
+{
+    if (cache == NULL)
+        return;
+
+    while (cache->regions != NULL)
+    {
+        smrregion_t *region = cache->regions;
+        cache->regions = region->next;
+        smr_unmap_region(region->addr, region->size);
+        free(region);
+    }
+
+    mtx_destroy(&cache->mutex);
+    free(cache);
+}
+
+/**
+ * Try to keep an unmap region in its warm cache.
+ * @returns true if cached
+*/
+static bool region_cache_put(smrregion_t *region)
+{
+    smrregion_cache_t *cache = region->cache;
+    if (region->flags != SMRPROXY_REGION_UNMAP)
+        return false;
+
+    bool cached = false;
+    mtx_lock(&cache->mutex);
+    if (cache->max != 0 && cache->bytes + region->size <= cache->max)
+    {
+        region->next = cache->regions;
+        cache->regions = region;
+        cache->bytes += region->size;
+        cached = true;
+    }
+    mtx_unlock(&cache->mutex);
+    return cached;
+}
+
+static void region_release(char *addr, size_t size, int flags)
+{
+    if (flags == SMRPROXY_REGION_DONTNEED)
+        smr_discard_region(addr, size);
+    else
+        smr_unmap_region(addr, size);
+}
+
+/*
+* single region dtor, used when the region batch dtor isn't registered
+*/
+static void region_free(void *obj)
+{
+    smrregion_t *region = obj;
+    if (region_cache_put(region))
+        return;
+    region_release(region->addr, region->size, region->flags);
+    free(region);
+}
+
+static int region_cmp(const void *a, const void *b)
+{
+    const smrregion_t *ra = *(smrregion_t * const *) a;
+    const smrregion_t *rb = *(smrregion_t * const *) b;
+    return (uintptr_t) ra->addr < (uintptr_t) rb->addr ? -1 : (uintptr_t) ra->addr > (uintptr_t) rb->addr;
+}
+
+/*
+* region batch dtor.  Regions not kept in the warm cache are sorted by
+* address and adjacent regions with the same flags are released with a
+* single munmap or madvise call.
+*/
+static void region_batch(void **objs, unsigned int count)
+{
+    unsigned int n = 0;
+    for (unsigned int ndx = 0; ndx < count; ndx++)
+    {
+        if (!region_cache_put(objs[ndx]))
+            objs[n++] = objs[ndx];
+    }
+
+    qsort(objs, n, sizeof(void *), &region_cmp);
+
+    char *addr = NULL;
+    size_t size = 0;
+    int flags = 0;
+    for (unsigned int ndx = 0; ndx < n; ndx++)
+    {
+        smrregion_t *region = objs[ndx];
+        if (size != 0 && region->flags == flags && addr + size == region->addr)
+            size += region->size;
+        else
+        {
+            if (size != 0)
+                region_release(addr, size, flags);
+            addr = region->addr;
+            size = region->size;
+            flags = region->flags;
+        }
+        free(region);
+    }
+    if (size != 0)
+        region_release(addr, size, flags);
+}
+
+/**
+ * Get proxy's region cache, creating it and registering the region
+ * batch dtor on first use.
+*/
+static smrregion_cache_t * get_cache(smrproxy_t *proxy)
+{
+    mtx_lock(&proxy->group->mutex);
+    if (proxy->regions == NULL)
+    {
+        proxy->regions = smrregion_cache_create();
+        if (proxy->regions != NULL)
+            smrqueue_register_batch(proxy->queue, &region_free, &region_batch);    // else regions released one at a time
+    }
+    smrregion_cache_t *cache = proxy->regions;
+    mtx_unlock(&proxy->group->mutex);
+    return cache;
+}
+
+epoch_t smrproxy_retire_region(smrproxy_t *proxy, void *addr, size_t size, int flags)
+{
+    smrregion_cache_t *cache = get_cache(proxy);
+    if (cache == NULL)
+        return 0;
+
+    smrregion_t *region = malloc(sizeof(smrregion_t));
+    if (region == NULL)
+        return 0;
+    region->next = NULL;
+    region->addr = addr;
+    region->size = size;
+    region->flags = flags;
+    region->cache = cache;
+
+    epoch_t epoch = smrproxy_retire(proxy, region, &region_free);
+    if (epoch == 0)
+        free(region);
+    return epoch;
+}
+
+int smrproxy_region_cache(smrproxy_t *proxy, size_t max)
+{
+    smrregion_cache_t *cache = get_cache(proxy);
+    if (cache == NULL)
+        return -1;
+
+    mtx_lock(&cache->mutex);
+    cache->max = max;
+    smrregion_t **pprev = &cache->regions;
+    while (cache->bytes > max)      // trim to new limit
+    {
+        smrregion_t *region = *pprev;
+        *pprev = region->next;
+        cache->bytes -= region->size;
+        smr_unmap_region(region->addr, region->size);
+        free(region);
+    }
+    mtx_unlock(&cache->mutex);
+    return 0;
+}
+
+void * smrproxy_region_alloc(smrproxy_t *proxy, size_t size)
+{
+    smrregion_cache_t *cache = get_cache(proxy);
+    if (cache != NULL)
+    {
+        smrregion_t *region = NULL;
+        mtx_lock(&cache->mutex);
+        for (smrregion_t **pprev = &cache->regions; *pprev != NULL; pprev = &(*pprev)->next)
+        {
+            if ((*pprev)->size == size)
+            {
+                region = *pprev;
+                *pprev = region->next;
+                cache->bytes -= size;
+                break;
+            }
+        }
+        mtx_unlock(&cache->mutex);
+
+        if (region != NULL)
+        {
+            void *addr = region->addr;
+            free(region);
+            return addr;
+        }
+    }
+
+    return smr_map_region(size);
+}
+
+/*-*/
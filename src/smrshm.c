@@ -0,0 +1,374 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <smrproxy_intr.h>
+#include <smrshm.h>
+
+#define SMRSHM_MAGIC 0x736d7273     // "smrs"
+#define SMRSHM_VERSION 2
+
+/*
+* fixed, not from getcachesize, so every process computes the same layout
+*/
+#define SMRSHM_LINE 128
+
+#define ROUNDUP(n) ((((n) + SMRSHM_LINE - 1) / SMRSHM_LINE) * SMRSHM_LINE)
+
+/*
+* region layout, all cache line aligned
+*
+*   header
+*   epoch
+*   reader slots
+*   retire queue
+*/
+typedef struct shm_header_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nslots;
+    uint32_t queue_size;
+    uint64_t size;              // size of proxy part of region
+
+    atomic_flag lock;           // retire queue lock
+
+    epoch_t head;               // retire queue, set by reclaimer only
+    epoch_t tail;
+    uint32_t head_ndx;
+    uint32_t tail_ndx;
+
+    epoch_t sync_epoch;         // last memorybarrier synced epoch, reclaimer only
+} shm_header_t;
+
+/*
+* reader slot
+*/
+typedef struct shm_slot_t {
+    smrproxy_ref_t ref;
+    atomic_int owner;           // owning process pid, 0 if free, -1 being initialized
+
+    _Alignas(SMRSHM_LINE) epoch_t effective_epoch;     // reclaimer only, own cache line
+} shm_slot_t;
+
+/*
+* retire queue entry
+*/
+typedef struct shm_entry_t {
+    uint64_t offset;
+    uint32_t dtor_id;
+} shm_entry_t;
+
+typedef struct smrshm_t {
+    char *base;
+    size_t size;
+
+    shm_header_t *hdr;
+    epoch_t *epoch;
+    char *slots;
+    shm_entry_t *queue;
+
+    smrproxy_membar_t *membar;
+
+    smrshm_dtor_t dtors[SMRSHM_MAX_DTORS];
+} smrshm_t;
+
+static const size_t slot_size = ROUNDUP(sizeof(shm_slot_t));
+
+static size_t slots_offset()
+{
+    return ROUNDUP(sizeof(shm_header_t)) + SMRSHM_LINE;
+}
+
+static size_t queue_offset(unsigned int nslots)
+{
+    return slots_offset() + nslots * slot_size;
+}
+
+static inline shm_slot_t * get_slot(smrshm_t *shm, unsigned int ndx)
+{
+    return (shm_slot_t *) (shm->slots + ndx * slot_size);
+}
+
+static inline void shm_lock(shm_header_t *hdr)
+{
+    while (atomic_flag_test_and_set_explicit(&hdr->lock, memory_order_acquire))
+        ;
+}
+
+static inline void shm_unlock(shm_header_t *hdr)
+{
+    atomic_flag_clear_explicit(&hdr->lock, memory_order_release);
+}
+
+size_t smrshm_size(unsigned int nslots, unsigned int queue_size)
+{
+    return ROUNDUP(queue_offset(nslots) + queue_size * sizeof(shm_entry_t));
+}
+
+static smrshm_t * shm_handle(void *base, size_t size)
+{
+    shm_header_t *hdr = base;
+
+    smrshm_t *shm = malloc(sizeof(smrshm_t));
+    if (shm == NULL)
+        return NULL;
+    memset(shm, 0, sizeof(smrshm_t));
+
+    shm->base = base;
+    shm->size = size;
+    shm->hdr = hdr;
+    shm->epoch = (epoch_t *) (shm->base + ROUNDUP(sizeof(shm_header_t)));
+    shm->slots = shm->base + slots_offset();
+    shm->queue = (shm_entry_t *) (shm->base + queue_offset(hdr->nslots));
+
+    shm->membar = smrproxy_membar_create_global();
+    if (shm->membar == NULL)
+    {
+        free(shm);
+        return NULL;
+    }
+
+    return shm;
+}
+
+smrshm_t * smrshm_init(void *base, size_t size, unsigned int nslots, unsigned int queue_size)
+{
+    if (((uintptr_t) base % SMRSHM_LINE) != 0 || size < smrshm_size(nslots, queue_size) || queue_size == 0)
+        return NULL;
+
+    size_t shm_size = smrshm_size(nslots, queue_size);
+    memset(base, 0, shm_size);
+
+    shm_header_t *hdr = base;
+    hdr->version = SMRSHM_VERSION;
+    hdr->nslots = nslots;
+    hdr->queue_size = queue_size;
+    hdr->size = shm_size;
+    atomic_flag_clear(&hdr->lock);
+
+    epoch_t epoch = 1;
+    hdr->head = epoch;
+    hdr->tail = epoch;
+    hdr->sync_epoch = epoch - 2;
+
+    smrshm_t *shm = shm_handle(base, size);
+    if (shm == NULL)
+        return NULL;
+
+    *shm->epoch = epoch;
+
+    atomic_store_explicit(&hdr->magic, SMRSHM_MAGIC, memory_order_release);
+    return shm;
+}
+
+smrshm_t * smrshm_attach(void *base, size_t size)
+{
+    shm_header_t *hdr = base;
+    if (atomic_load_explicit(&hdr->magic, memory_order_acquire) != SMRSHM_MAGIC
+        || hdr->version != SMRSHM_VERSION
+        || hdr->size > size)
+        return NULL;
+
+    return shm_handle(base, size);
+}
+
+void smrshm_detach(smrshm_t *shm)
+{
+    int pid = getpid();
+    for (unsigned int ndx = 0; ndx < shm->hdr->nslots; ndx++)
+    {
+        shm_slot_t *slot = get_slot(shm, ndx);
+        if (atomic_load_explicit(&slot->owner, memory_order_relaxed) == pid)
+            smrshm_ref_destroy(&slot->ref);
+    }
+
+    smrproxy_membar_destroy(shm->membar);
+    free(shm);
+}
+
+smrproxy_ref_t * smrshm_ref_create(smrshm_t *shm)
+{
+    for (unsigned int ndx = 0; ndx < shm->hdr->nslots; ndx++)
+    {
+        shm_slot_t *slot = get_slot(shm, ndx);
+        int expected = 0;
+        if (!atomic_compare_exchange_strong_explicit(&slot->owner, &expected, -1, memory_order_acquire, memory_order_relaxed))
+            continue;
+
+        epoch_t epoch = atomic_load_explicit(shm->epoch, memory_order_acquire);
+        slot->ref.proxy_epoch = NULL;       // not meaningful across processes
+        slot->ref.epoch = 0;
+        slot->ref.current_epoch = epoch;
+        slot->effective_epoch = epoch;
+        slot->ref.data = 0;
+
+        atomic_store_explicit(&slot->owner, getpid(), memory_order_release);
+        return &slot->ref;
+    }
+
+    return NULL;
+}
+
+void smrshm_ref_destroy(smrproxy_ref_t *ref)
+{
+    shm_slot_t *slot = (shm_slot_t *) ref;
+    smrproxy_ref_release(ref);
+    atomic_store_explicit(&slot->owner, 0, memory_order_release);
+}
+
+epoch_t smrshm_retire(smrshm_t *shm, uint64_t offset, unsigned int dtor_id)
+{
+    shm_header_t *hdr = shm->hdr;
+
+    shm_lock(hdr);
+
+    if ((hdr->tail - hdr->head) == 2 * hdr->queue_size)
+    {
+        shm_unlock(hdr);
+        return 0;
+    }
+
+    shm_entry_t *entry = &shm->queue[hdr->tail_ndx];
+    entry->offset = offset;
+    entry->dtor_id = dtor_id;
+
+    hdr->tail_ndx = (hdr->tail_ndx + 1) % hdr->queue_size;
+    hdr->tail += 2;
+
+    epoch_t epoch = hdr->tail;
+    atomic_store_explicit(shm->epoch, epoch, memory_order_release);
+
+    shm_unlock(hdr);
+    return epoch;
+}
+
+int smrshm_register_dtor(smrshm_t *shm, unsigned int dtor_id, smrshm_dtor_t dtor)
+{
+    if (dtor_id >= SMRSHM_MAX_DTORS)
+        return -1;
+    shm->dtors[dtor_id] = dtor;
+    return 0;
+}
+
+static bool process_exited(int pid)
+{
+    return kill(pid, 0) == -1 && errno == ESRCH;
+}
+
+/*
+* same logic as update_effective_epochs in smrproxy.c
+*/
+static epoch_t shm_update_effective_epochs(smrshm_t *shm, epoch_t effective)
+{
+    shm_header_t *hdr = shm->hdr;
+    epoch_t current_epoch = atomic_load_explicit(shm->epoch, memory_order_acquire);
+    epoch_t oldest = current_epoch;
+
+    for (unsigned int ndx = 0; ndx < hdr->nslots; ndx++)
+    {
+        shm_slot_t *slot = get_slot(shm, ndx);
+        int owner = atomic_load_explicit(&slot->owner, memory_order_acquire);
+        if (owner <= 0)
+            continue;
+
+        smrproxy_ref_t *ref = &slot->ref;
+
+        /*
+        * free slot if owner has exited, in or out of a read section
+        */
+        if (process_exited(owner))
+        {
+            smrshm_ref_destroy(ref);
+            continue;
+        }
+
+        if (atomic_load_explicit(&ref->current_epoch, memory_order_relaxed) != current_epoch)
+            atomic_store_explicit(&ref->current_epoch, current_epoch, memory_order_relaxed);
+        epoch_t ref_epoch = atomic_load_explicit(&ref->epoch, memory_order_relaxed);
+        if (ref_epoch == 0)
+            slot->effective_epoch = effective;
+        else if (xcmp(ref_epoch, slot->effective_epoch) > 0)
+            slot->effective_epoch = ref_epoch;
+
+        epoch_t effective_epoch = slot->effective_epoch;
+
+        if (xcmp(effective_epoch, hdr->head) < 0)
+            continue;
+
+        if (xcmp(effective_epoch, oldest) < 0)
+            oldest = effective_epoch;
+    }
+
+    return oldest;
+}
+
+unsigned int smrshm_reclaim(smrshm_t *shm)
+{
+    shm_header_t *hdr = shm->hdr;
+
+    epoch_t epoch = atomic_load_explicit(shm->epoch, memory_order_acquire);
+    if (epoch != hdr->sync_epoch)
+    {
+        hdr->sync_epoch = epoch;
+        smrproxy_membar_sync(shm->membar);
+        atomic_thread_fence(memory_order_seq_cst);
+    }
+
+    epoch_t head = hdr->head;           // only changed here
+    if (head == epoch)
+        return 0;                       // queue empty
+
+    epoch_t oldest = shm_update_effective_epochs(shm, hdr->sync_epoch);
+
+    /*
+    * entries [head, oldest) can't be reused by retirers until head is updated
+    */
+    unsigned int count = 0;
+    uint32_t head_ndx = hdr->head_ndx;
+    for (; xcmp(head, oldest) < 0; head += 2)
+    {
+        shm_entry_t *entry = &shm->queue[head_ndx];
+        smrshm_dtor_t dtor = entry->dtor_id < SMRSHM_MAX_DTORS ? shm->dtors[entry->dtor_id] : NULL;
+        if (dtor != NULL)
+            (*dtor)(shm->base, entry->offset);      // else leaked, no destructor registered
+        head_ndx = (head_ndx + 1) % hdr->queue_size;
+        count++;
+    }
+
+    shm_lock(hdr);
+    hdr->head = head;
+    hdr->head_ndx = head_ndx;
+    shm_unlock(hdr);
+
+    return count;
+}
+
+void * smrshm_ptr(smrshm_t *shm, uint64_t offset)
+{
+    return shm->base + offset;
+}
+
+uint64_t smrshm_offset(smrshm_t *shm, void *ptr)
+{
+    return (char *) ptr - shm->base;
+}
@@ -0,0 +1,103 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include <smrproxy_intr.h>
+#include <smrtrace.h>
+
+typedef struct smrtrace_t {
+    smrtrace_header_t *header;
+    smrtrace_rec_t *ring;
+    size_t size;                // mapped size
+    uint64_t start;             // smr_gettime at trace start
+} smrtrace_t;
+
+/**
+ * Append a record, proxy mutex must be held.
+*/
+void smrtrace_record(smrtrace_t *trace, unsigned int type, uint32_t a, uint32_t b, uint32_t c)
+{
+    smrtrace_header_t *header = trace->header;
+    uint64_t count = header->count;
+
+    smrtrace_rec_t *rec = &trace->ring[count % header->capacity];
+    rec->time = smr_gettime() - trace->start;
+    rec->type = type;
+    rec->a = a;
+    rec->b = b;
+    rec->c = c;
+
+    atomic_store_explicit(&header->count, count + 1, memory_order_release);     // for live readers of the file
+}
+
+int smrproxy_trace_start(smrproxy_t *proxy, const char *path, size_t capacity)
+{
+    if (capacity == 0)
+        return -1;
+
+    smrtrace_t *trace = malloc(sizeof(smrtrace_t));
+    if (trace == NULL)
+        return -1;
+
+    size_t size = sizeof(smrtrace_header_t) + capacity * sizeof(smrtrace_rec_t);
+    void *base = smr_map_file(path, size);
+    if (base == NULL)
+    {
+        free(trace);
+        return -1;
+    }
+
+    trace->header = base;
+    trace->ring = (smrtrace_rec_t *) ((char *) base + sizeof(smrtrace_header_t));
+    trace->size = size;
+    trace->start = smr_gettime();
+
+    smrtrace_header_t *header = trace->header;
+    header->magic = SMRTRACE_MAGIC;
+    header->version = SMRTRACE_VERSION;
+    header->capacity = capacity;
+    header->count = 0;
+    proxy = proxy->group;       // group members trace to their leader's trace
+    header->queue_size = proxy->config.queue_size;
+    header->polltime = proxy->config.polltime;
+
+    smrproxy_trace_stop(proxy);
+
+    mtx_lock(&proxy->mutex);
+    proxy->trace = trace;
+    mtx_unlock(&proxy->mutex);
+
+    return 0;
+}
+
+void smrproxy_trace_stop(smrproxy_t *proxy)
+{
+    proxy = proxy->group;
+    mtx_lock(&proxy->mutex);
+    smrtrace_t *trace = proxy->trace;
+    proxy->trace = NULL;
+    mtx_unlock(&proxy->mutex);
+
+    if (trace == NULL)
+        return;
+
+    smr_unmap_file(trace->header, trace->size);
+    free(trace);
+}
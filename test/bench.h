@@ -0,0 +1,212 @@
+/*
+   Copyright 2023 Joseph W. Seigh
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+/*
+* shared benchmark helpers, test data, timing, latency histograms and cache miss counters
+*/
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BENCH_VALUES 4
+
+/*
+* shared data, writers set all values the same so readers can check consistency
+*/
+typedef struct bench_data_t {
+    uint64_t value[BENCH_VALUES];
+} bench_data_t;
+
+inline static uint64_t bench_data_sum(const bench_data_t *data)
+{
+    uint64_t sum = 0;
+    for (int ndx = 0; ndx < BENCH_VALUES; ndx++)
+        sum += data->value[ndx];
+    return sum;
+}
+
+inline static void bench_data_set(bench_data_t *data, uint64_t value)
+{
+    for (int ndx = 0; ndx < BENCH_VALUES; ndx++)
+        data->value[ndx] = value;
+}
+
+/*
+* timing, rdtsc where available otherwise the monotonic clock in nanoseconds
+*/
+inline static uint64_t bench_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+inline static uint64_t bench_nanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/*
+* ticks per nanosecond
+*/
+inline static double bench_calibrate()
+{
+    uint64_t t0 = bench_ticks();
+    uint64_t n0 = bench_nanos();
+    struct timespec ts = { 0, 50000000 };
+    nanosleep(&ts, NULL);
+    uint64_t t1 = bench_ticks();
+    uint64_t n1 = bench_nanos();
+    return (double) (t1 - t0) / (double) (n1 - n0);
+}
+
+/*
+* log linear latency histogram, 8 sub-buckets per power of 2
+*/
+#define BENCH_HIST_SUB 8
+#define BENCH_HIST_SIZE (62 * BENCH_HIST_SUB)
+
+typedef struct bench_hist_t {
+    uint64_t count[BENCH_HIST_SIZE];
+    uint64_t total;
+    uint64_t max;
+} bench_hist_t;
+
+inline static int bench_hist_index(uint64_t value)
+{
+    if (value < BENCH_HIST_SUB)
+        return (int) value;
+    int msb = 63 - __builtin_clzll(value);
+    int sub = (int) (value >> (msb - 3)) & (BENCH_HIST_SUB - 1);
+    return (msb - 2) * BENCH_HIST_SUB + sub;
+}
+
+inline static uint64_t bench_hist_value(int ndx)
+{
+    if (ndx < BENCH_HIST_SUB)
+        return ndx;
+    int msb = ndx / BENCH_HIST_SUB + 2;
+    int sub = ndx % BENCH_HIST_SUB;
+    return (uint64_t) (BENCH_HIST_SUB + sub) << (msb - 3);
+}
+
+inline static void bench_hist_record(bench_hist_t *hist, uint64_t value)
+{
+    hist->count[bench_hist_index(value)]++;
+    hist->total++;
+    if (value > hist->max)
+        hist->max = value;
+}
+
+inline static void bench_hist_merge(bench_hist_t *hist, const bench_hist_t *other)
+{
+    for (int ndx = 0; ndx < BENCH_HIST_SIZE; ndx++)
+        hist->count[ndx] += other->count[ndx];
+    hist->total += other->total;
+    if (other->max > hist->max)
+        hist->max = other->max;
+}
+
+/*
+* value at percentile, 0.0 - 100.0
+*/
+inline static uint64_t bench_hist_percentile(const bench_hist_t *hist, double pct)
+{
+    uint64_t target = (uint64_t) (hist->total * pct / 100.0);
+    uint64_t count = 0;
+    for (int ndx = 0; ndx < BENCH_HIST_SIZE; ndx++)
+    {
+        count += hist->count[ndx];
+        if (count > target)
+            return bench_hist_value(ndx);
+    }
+    return hist->max;
+}
+
+/*
+* calling thread's L1 data cache read misses, hardware counter
+* from perf_event_open.  -1 if counters aren't available.
+*/
+inline static int bench_misses_open()
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_L1D
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    return -1;
+#endif
+}
+
+inline static int64_t bench_misses_read(int fd)
+{
+    uint64_t count;
+    if (fd == -1 || read(fd, &count, sizeof(count)) != sizeof(count))
+        return -1;
+    return (int64_t) count;
+}
+
+inline static void bench_misses_close(int fd)
+{
+    if (fd != -1)
+        close(fd);
+}
+
+/*
+* std::atomic<std::shared_ptr> baseline, bench_shared_ptr.cpp
+*/
+typedef struct bench_sp_t bench_sp_t;
+
+extern bench_sp_t * bench_sp_create();
+extern void bench_sp_destroy(bench_sp_t *sp);
+extern uint64_t bench_sp_read(bench_sp_t *sp);
+extern void bench_sp_write(bench_sp_t *sp, uint64_t value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCH_H */
@@ -0,0 +1,37 @@
+/*
+ * std::atomic<std::shared_ptr> baseline for smrproxy_bench
+*/
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+#include "bench.h"
+
+struct bench_sp_t {
+    std::atomic<std::shared_ptr<bench_data_t>> data;
+};
+
+extern "C" bench_sp_t * bench_sp_create()
+{
+    bench_sp_t *sp = new bench_sp_t();
+    sp->data.store(std::make_shared<bench_data_t>());
+    return sp;
+}
+
+extern "C" void bench_sp_destroy(bench_sp_t *sp)
+{
+    delete sp;
+}
+
+extern "C" uint64_t bench_sp_read(bench_sp_t *sp)
+{
+    std::shared_ptr<bench_data_t> data = sp->data.load(std::memory_order_acquire);
+    return bench_data_sum(data.get());
+}
+
+extern "C" void bench_sp_write(bench_sp_t *sp, uint64_t value)
+{
+    std::shared_ptr<bench_data_t> data = std::make_shared<bench_data_t>();
+    bench_data_set(data.get(), value);
+    sp->data.store(std::move(data), std::memory_order_release);
+}
@@ -12,6 +12,8 @@
 /**
  * Example of using smrproxy_ref_next to implements a multi-headed queue as an event listener.
  * The listener threads use an smrproxy_ref_t as a private queue head.
+ * Listeners wait for new events with smrproxy_wait_epoch, each push
+ * retires the previous node which advances the proxy epoch.
 */
 
 typedef struct node_t {
@@ -25,10 +27,7 @@ typedef struct node_t {
 typedef struct {
     smrproxy_t *proxy;
 
-    pnode_t events;
-
-    mtx_t mutex;
-    cnd_t cvar;
+    pnode_t events;     // single writer
 
     pthread_barrier_t barrier;
 
@@ -68,8 +67,6 @@ static void push(queue_t *queue, const int event_id)
     node->next = NULL;
     node->event_id = 0;
 
-    mtx_lock(&queue->mutex);
-
     pnode_t current = queue->events;
     current->event_id = event_id;
 
@@ -79,11 +76,7 @@ static void push(queue_t *queue, const int event_id)
     epoch_t expiry = smrproxy_get_epoch(queue->proxy);
     fprintf(stdout, "retiring event_id=%d expiry=%lu\n", event_id, expiry);
 
-    smrproxy_retire_exp(queue->proxy, current, &free_node, &setexpiry, NULL);
-
-    cnd_broadcast(&queue->cvar);
-    mtx_unlock(&queue->mutex);
-
+    smrproxy_retire_exp(queue->proxy, current, &free_node, &setexpiry, NULL);    // advances epoch, wakes listeners
 }
 
 /*
@@ -111,15 +104,12 @@ static int listen(void *arg)
     for (;;)
     {
 
-        if (atomic_load_explicit(&node->next, memory_order_acquire) == NULL)
-        //if (node->next == NULL)
+        for (;;)
         {
-            mtx_lock(&queue->mutex);
-            while (node->next == NULL)
-            {
-                cnd_wait(&queue->cvar, &queue->mutex);
-            }
-            mtx_unlock(&queue->mutex);
+            epoch_t seen = smrproxy_get_epoch(proxy);   // before checking for next event
+            if (atomic_load_explicit(&node->next, memory_order_acquire) != NULL)
+                break;
+            smrproxy_wait_epoch(proxy, seen, NULL);
         }
 
         epoch_t prev_epoch = ref->epoch;
@@ -153,8 +143,6 @@ int main(int argc, char **argv)
     queue_t *queue = malloc(sizeof(queue_t));
     memset(queue, 0, sizeof(queue_t));
     queue->proxy = smrproxy_create(config);
-    mtx_init(&queue->mutex, mtx_plain);
-    cnd_init(&queue->cvar);
     pthread_barrier_init(&queue->barrier, NULL, 3);
     queue->events = malloc(sizeof(node_t));
     memset(queue->events, 0, sizeof(node_t));
@@ -180,8 +168,6 @@ int main(int argc, char **argv)
     smrproxy_destroy(queue->proxy);
     free_node(queue->events);
     pthread_barrier_destroy(&queue->barrier);
-    cnd_destroy(&queue->cvar);
-    mtx_destroy(&queue->mutex);
     free(queue);
 
     return 0;
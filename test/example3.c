@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include <smrproxy.h>
+#include <smrevent.h>
+
+/**
+ * Example of using the smrevent broadcast queue as an in-process pub/sub bus.
+ * Several producers publish, every listener sees every event.
+*/
+
+#define PRODUCERS 2
+#define LISTENERS 3
+#define EVENTS 20
+
+typedef struct {
+    int producer;
+    int event_id;       // -1 is end of events from producer
+} event_t;
+
+typedef struct {
+    smrevent_t *queue;
+    pthread_barrier_t barrier;
+    int producer;
+} env_t;
+
+static void free_event(void *x)
+{
+    free(x);
+}
+
+static void sleep(unsigned int millis)
+{
+    struct timespec time = { millis / 1000, (millis % 1000) * 1000000};
+    thrd_sleep(&time, NULL);
+}
+
+static int produce(void *arg)
+{
+    env_t *env = arg;
+    int producer = atomic_fetch_add(&env->producer, 1);
+
+    pthread_barrier_wait(&env->barrier);
+
+    for (int ndx = 0; ndx <= EVENTS; ndx++)
+    {
+        event_t *event = malloc(sizeof(event_t));
+        event->producer = producer;
+        event->event_id = ndx < EVENTS ? 1000 + ndx : -1;
+        smrevent_publish(env->queue, event);
+        sleep(20);
+    }
+    return 0;
+}
+
+static int listen(void *arg)
+{
+    env_t *env = arg;
+    thrd_t tid = thrd_current();
+
+    smrevent_listener_t *listener = smrevent_listen(env->queue);
+
+    pthread_barrier_wait(&env->barrier);
+
+    int done = 0;
+    int count = 0;
+    void *events[8];
+    while (done < PRODUCERS)
+    {
+        size_t n = smrevent_read(listener, events, 8);
+        if (n == 0)
+        {
+            smrevent_wait(listener, NULL);
+            continue;
+        }
+
+        for (size_t ndx = 0; ndx < n; ndx++)
+        {
+            event_t *event = events[ndx];
+            if (event->event_id == -1)
+                done++;
+            else
+                count++;
+        }
+        fprintf(stdout, "%lu) read batch of %zu events\n", tid, n);
+    }
+
+    smrevent_unlisten(listener);
+
+    fprintf(stdout, "%lu) received %d events\n", tid, count);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    smrproxy_t *proxy = smrproxy_create(NULL);
+
+    env_t env;
+    env.queue = smrevent_create(proxy, &free_event);
+    env.producer = 0;
+    pthread_barrier_init(&env.barrier, NULL, PRODUCERS + LISTENERS);
+
+    thrd_t listeners[LISTENERS];
+    thrd_t producers[PRODUCERS];
+
+    for (int ndx = 0; ndx < LISTENERS; ndx++)
+        thrd_create(&listeners[ndx], &listen, &env);
+    for (int ndx = 0; ndx < PRODUCERS; ndx++)
+        thrd_create(&producers[ndx], &produce, &env);
+
+    for (int ndx = 0; ndx < PRODUCERS; ndx++)
+        thrd_join(producers[ndx], NULL);
+    for (int ndx = 0; ndx < LISTENERS; ndx++)
+        thrd_join(listeners[ndx], NULL);
+
+    smrevent_destroy(env.queue);
+    smrproxy_destroy(proxy);
+    pthread_barrier_destroy(&env.barrier);
+
+    return 0;
+}
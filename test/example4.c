@@ -0,0 +1,183 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <smrproxy.h>
+#include <smrshm.h>
+
+/**
+ * Example of a shared memory smrproxy with reader processes.
+ *
+ * The parent process owns a memfd shared memory region holding the proxy,
+ * a shared pointer (an offset) and a pool of data objects.  It replaces the
+ * current object, retires the old one and reclaims.  Forked reader processes
+ * attach to the region and check they never see a reclaimed object.  The
+ * parent waits until every reader is reading before it starts updating.
+ *
+ * usage: example4 [readers [updates]]
+*/
+
+#define NSLOTS 16
+#define QUEUE_SIZE 64
+#define POOL_SIZE (QUEUE_SIZE + NSLOTS + 2)
+#define POISON 0xdeaddeaddeaddeadull
+
+#define DTOR_OBJECT 0
+
+typedef struct {
+    uint64_t value[4];      // all the same while live, POISON once reclaimed
+} object_t;
+
+/*
+* application part of region, after the proxy
+*/
+typedef struct {
+    uint64_t shared;        // offset of current object
+    atomic_int ready;       // readers started
+    atomic_bool stop;
+    object_t pool[POOL_SIZE];
+} appdata_t;
+
+/*
+* object free list, parent process only
+*/
+static uint64_t free_list[POOL_SIZE];
+static int free_count = 0;
+
+static void free_object(void *base, uint64_t offset)
+{
+    object_t *object = (object_t *) ((char *) base + offset);
+    for (int ndx = 0; ndx < 4; ndx++)
+        object->value[ndx] = POISON;
+    free_list[free_count++] = offset;
+}
+
+static int reader(void *base, size_t size, appdata_t *app)
+{
+    smrshm_t *shm = smrshm_attach(base, size);
+    if (shm == NULL)
+    {
+        fprintf(stderr, "reader %d: attach failed\n", getpid());
+        atomic_fetch_add(&app->ready, 1);
+        return 2;
+    }
+    smrproxy_ref_t *ref = smrshm_ref_create(shm);
+
+    unsigned long reads = 0, errors = 0;
+    while (!atomic_load_explicit(&app->stop, memory_order_relaxed))
+    {
+        smrshm_ref_acquire(ref);
+        uint64_t offset = atomic_load_explicit(&app->shared, memory_order_acquire);
+        object_t *object = smrshm_ptr(shm, offset);
+        uint64_t value = object->value[0];
+        for (int ndx = 1; ndx < 4; ndx++)
+            if (object->value[ndx] != value)
+                errors++;
+        if (value == POISON)
+            errors++;
+        smrshm_ref_release(ref);
+        if (reads++ == 0)
+            atomic_fetch_add(&app->ready, 1);
+    }
+
+    printf("reader %d: reads=%lu errors=%lu\n", getpid(), reads, errors);
+
+    smrshm_ref_destroy(ref);
+    smrshm_detach(shm);
+    return errors == 0 && reads > 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    int nreaders = argc > 1 ? atoi(argv[1]) : 3;
+    int updates = argc > 2 ? atoi(argv[2]) : 10000;
+
+    size_t shm_size = smrshm_size(NSLOTS, QUEUE_SIZE);
+    size_t size = shm_size + sizeof(appdata_t);
+
+    int fd = memfd_create("smrshm_example", 0);
+    if (fd == -1 || ftruncate(fd, size) != 0)
+    {
+        perror("memfd_create");
+        return 1;
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+    {
+        perror("mmap");
+        return 1;
+    }
+
+    smrshm_t *shm = smrshm_init(base, size, NSLOTS, QUEUE_SIZE);
+    if (shm == NULL)
+    {
+        fprintf(stderr, "smrshm_init failed\n");
+        return 1;
+    }
+    smrshm_register_dtor(shm, DTOR_OBJECT, &free_object);
+
+    appdata_t *app = (appdata_t *) ((char *) base + shm_size);
+    for (int ndx = 1; ndx < POOL_SIZE; ndx++)
+        free_object(base, smrshm_offset(shm, &app->pool[ndx]));
+    memset(&app->pool[0], 0, sizeof(object_t));
+    app->shared = smrshm_offset(shm, &app->pool[0]);
+
+    for (int ndx = 0; ndx < nreaders; ndx++)
+    {
+        if (fork() == 0)
+            exit(reader(base, size, app));      // fork keeps mapping, memfd could also be passed to unrelated processes
+    }
+
+    while (atomic_load(&app->ready) < nreaders)
+        usleep(1000);
+
+    unsigned long retry = 0;
+    for (int n = 1; n <= updates; n++)
+    {
+        while (free_count == 0)
+        {
+            smrshm_reclaim(shm);
+            retry++;
+        }
+
+        uint64_t offset = free_list[--free_count];
+        object_t *object = smrshm_ptr(shm, offset);
+        for (int ndx = 0; ndx < 4; ndx++)
+            object->value[ndx] = n;
+
+        uint64_t old = atomic_exchange_explicit(&app->shared, offset, memory_order_acq_rel);
+        while (smrshm_retire(shm, old, DTOR_OBJECT) == 0)
+        {
+            smrshm_reclaim(shm);        // queue full
+            retry++;
+        }
+
+        if ((n % 16) == 0)
+            smrshm_reclaim(shm);
+    }
+
+    atomic_store(&app->stop, true);
+
+    int failed = 0;
+    for (int ndx = 0; ndx < nreaders; ndx++)
+    {
+        int status;
+        wait(&status);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed++;
+    }
+
+    smrshm_reclaim(shm);
+    printf("writer: updates=%d reclaim_retries=%lu failed_readers=%d\n", updates, retry, failed);
+
+    smrshm_detach(shm);
+    munmap(base, size);
+    close(fd);
+    return failed == 0 ? 0 : 1;
+}
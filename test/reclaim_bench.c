@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <smrproxy.h>
+
+#include "bench.h"
+
+/**
+ * Reclamation footprint and reader tail latency under sustained writes.
+ *
+ * Sweeps queue_size, polltime, reader hold time and writer retire rate.
+ * For each combination records retire to dtor latency, peak pending
+ * (retired but not yet reclaimed) objects, retires that failed because
+ * the retire queue was full, membarrier calls, and reader latency.
+ *
+ * usage: reclaim_bench [millis per run [output file]]
+ *
+ * Output is csv.
+*/
+
+typedef struct {
+    uint64_t retired;           // bench_nanos() at retire
+    uint64_t value;
+} object_t;
+
+typedef struct {
+    smrproxy_t *proxy;
+    object_t *pdata;
+
+    unsigned int hold_us;       // reader hold time
+    unsigned int rate;          // retires per second, 0 is unlimited
+
+    atomic_bool stop;
+
+    atomic_ulong freed;         // dtor count
+    atomic_bool draining;       // proxy being destroyed, don't record r2d
+    bench_hist_t r2d;           // retire to dtor latency, nanoseconds, dtors only run on poll thread
+
+    unsigned long retires;
+    unsigned long failures;
+    unsigned long peak_pending;
+} env_t;
+
+typedef struct {
+    env_t *env;
+    bench_hist_t hist;          // reader latency, ticks
+} reader_t;
+
+static env_t *genv;             // for dtor
+
+static const unsigned int queue_sizes[] = { 100, 1000, 10000 };
+static const unsigned int polltimes[] = { 1, 10, 50 };
+static const unsigned int hold_times[] = { 0, 100, 1000 };
+static const unsigned int rates[] = { 10000, 100000, 0 };
+
+#define COUNT(a) (sizeof(a) / sizeof(a[0]))
+
+static void free_object(void *x)
+{
+    object_t *object = x;
+    if (!atomic_load_explicit(&genv->draining, memory_order_relaxed))
+        bench_hist_record(&genv->r2d, bench_nanos() - object->retired);
+    atomic_fetch_add_explicit(&genv->freed, 1, memory_order_relaxed);
+    free(object);
+}
+
+static void spin_until(uint64_t deadline)
+{
+    while (bench_nanos() < deadline)
+        ;
+}
+
+static int reader(void *arg)
+{
+    reader_t *rdr = arg;
+    env_t *env = rdr->env;
+    smrproxy_ref_t *ref = smrproxy_ref_create(env->proxy);
+    uint64_t sum = 0;
+
+    while (!atomic_load_explicit(&env->stop, memory_order_relaxed))
+    {
+        uint64_t t0 = bench_ticks();
+        smrproxy_ref_acquire(ref);
+        object_t *object = atomic_load_explicit(&env->pdata, memory_order_acquire);
+        sum += object->value;
+        uint64_t t1 = bench_ticks();
+
+        if (env->hold_us != 0)
+            spin_until(bench_nanos() + env->hold_us * 1000ull);
+
+        uint64_t t2 = bench_ticks();
+        smrproxy_ref_release(ref);
+        uint64_t t3 = bench_ticks();
+
+        bench_hist_record(&rdr->hist, (t1 - t0) + (t3 - t2));     // excludes hold time
+    }
+
+    smrproxy_ref_destroy(ref);
+    return (int) (sum & 1);
+}
+
+static int writer(void *arg)
+{
+    env_t *env = arg;
+    uint64_t interval = env->rate != 0 ? 1000000000ull / env->rate : 0;
+    uint64_t next = bench_nanos();
+
+    while (!atomic_load_explicit(&env->stop, memory_order_relaxed))
+    {
+        if (interval != 0)
+        {
+            next += interval;
+            spin_until(next);
+        }
+
+        object_t *object = malloc(sizeof(object_t));
+        object->value = env->retires;
+        object = atomic_exchange_explicit(&env->pdata, object, memory_order_acq_rel);
+
+        object->retired = bench_nanos();
+        while (smrproxy_retire(env->proxy, object, &free_object) == 0)
+        {
+            env->failures++;
+            thrd_yield();
+            if (atomic_load_explicit(&env->stop, memory_order_relaxed))
+            {
+                // let destroy reclaim it
+                while (smrproxy_retire(env->proxy, object, &free_object) == 0)
+                    thrd_yield();
+                break;
+            }
+        }
+        env->retires++;
+
+        unsigned long pending = env->retires - atomic_load_explicit(&env->freed, memory_order_relaxed);
+        if (pending > env->peak_pending)
+            env->peak_pending = pending;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int millis = argc > 1 ? atoi(argv[1]) : 250;
+    FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (out == NULL)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int nreaders = ncpu > 2 ? ncpu - 1 : 1;
+    double ticks_per_ns = bench_calibrate();
+
+    fprintf(out, "queue_size,polltime,hold_us,rate,readers,seconds,retires,retire_failures,membarriers,peak_pending,"
+        "r2d_p50_us,r2d_p99_us,r2d_max_us,read_p50_ns,read_p99_ns,read_p999_ns\n");
+
+    env_t *env = malloc(sizeof(env_t));
+    genv = env;
+
+    for (unsigned int q = 0; q < COUNT(queue_sizes); q++)
+    for (unsigned int p = 0; p < COUNT(polltimes); p++)
+    for (unsigned int h = 0; h < COUNT(hold_times); h++)
+    for (unsigned int r = 0; r < COUNT(rates); r++)
+    {
+        memset(env, 0, sizeof(env_t));
+
+        smrproxy_config_t *config = smrproxy_default_config();
+        config->queue_size = queue_sizes[q];
+        config->polltime = polltimes[p];
+        env->proxy = smrproxy_create(config);
+        env->pdata = malloc(sizeof(object_t));
+        env->pdata->value = 0;
+        env->hold_us = hold_times[h];
+        env->rate = rates[r];
+
+        thrd_t tids[nreaders];
+        reader_t *readers = calloc(nreaders, sizeof(reader_t));
+        thrd_t writer_tid;
+
+        uint64_t start = bench_nanos();
+        for (int ndx = 0; ndx < nreaders; ndx++)
+        {
+            readers[ndx].env = env;
+            thrd_create(&tids[ndx], &reader, &readers[ndx]);
+        }
+        thrd_create(&writer_tid, &writer, env);
+
+        struct timespec ts = { millis / 1000, (millis % 1000) * 1000000 };
+        thrd_sleep(&ts, NULL);
+        atomic_store(&env->stop, true);
+
+        thrd_join(writer_tid, NULL);
+        for (int ndx = 0; ndx < nreaders; ndx++)
+            thrd_join(tids[ndx], NULL);
+        double elapsed = (bench_nanos() - start) * 1e-9;
+
+        unsigned long membars = smrproxy_get_membar_count(env->proxy);
+
+        /*
+        * destroy joins the poll thread before r2d is read, objects
+        * freed by destroy itself aren't recorded
+        */
+        atomic_store(&env->draining, true);
+        smrproxy_destroy(env->proxy);
+        bench_hist_t *r2d = &env->r2d;
+
+        bench_hist_t *hist = calloc(1, sizeof(bench_hist_t));
+        for (int ndx = 0; ndx < nreaders; ndx++)
+            bench_hist_merge(hist, &readers[ndx].hist);
+
+        fprintf(out, "%u,%u,%u,%u,%d,%.3f,%lu,%lu,%lu,%lu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+            queue_sizes[q], polltimes[p], hold_times[h], rates[r], nreaders, elapsed,
+            env->retires, env->failures, membars, env->peak_pending,
+            bench_hist_percentile(r2d, 50.0) * 1e-3,
+            bench_hist_percentile(r2d, 99.0) * 1e-3,
+            r2d->max * 1e-3,
+            bench_hist_percentile(hist, 50.0) / ticks_per_ns,
+            bench_hist_percentile(hist, 99.0) / ticks_per_ns,
+            bench_hist_percentile(hist, 99.9) / ticks_per_ns);
+        fflush(out);
+
+        free(env->pdata);
+        free(config);
+        free(readers);
+        free(hist);
+    }
+
+    free(env);
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
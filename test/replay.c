@@ -0,0 +1,386 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include <string.h>
+
+#include <smrproxy.h>
+#include <smrtrace.h>
+
+#include "bench.h"
+
+/**
+ * Replay a recorded smrproxy trace against other configurations.
+ *
+ * usage:
+ *   replay record <trace file> [millis]
+ *       record a trace of a synthetic workload, for trying out replay
+ *   replay <trace file> [queue_size polltime policy]
+ *       replay trace with given settings, or sweep queue_size,
+ *       polltime and policy if none given
+ *
+ * Retires are replayed at their recorded times and expiry epochs.
+ * Reader epochs are taken from the ref samples recorded when the traced
+ * proxy scanned its refs, a reader is assumed to keep its sampled epoch
+ * until its next sample.  Polls happen every polltime milliseconds and,
+ * depending on policy:
+ *   signal   also on every retire, the current smrproxy behavior
+ *   timer    only on the timer
+ *   half     also on a retire that leaves the queue half full
+ *
+ * A retire into a full queue is counted as a failure and waits in a
+ * backlog, its grace period includes the wait.
+ *
+ * Output is csv, pending objects and grace period, retire to reclaim,
+ * latency for each run.
+*/
+
+typedef enum { SIGNAL, TIMER, HALF } policy_t;
+static const char *policy_names[] = { "signal", "timer", "half" };
+#define POLICIES 3
+
+typedef struct {
+    uint64_t time;
+    uint32_t type;
+    uint32_t a;
+    uint32_t b;
+} event_t;
+
+typedef struct {
+    event_t *events;
+    size_t count;
+    unsigned int max_ref;
+    smrtrace_header_t header;
+} trace_t;
+
+typedef struct {
+    uint64_t time;              // retire time
+    epoch_t expiry;
+} pending_t;
+
+typedef struct {
+    unsigned int queue_size;
+    uint64_t polltime;          // nanoseconds
+    policy_t policy;
+
+    pending_t *queue;           // ring of queue_size
+    unsigned int head;
+    unsigned int count;
+
+    pending_t *backlog;         // failed retires, unbounded
+    size_t backlog_head;
+    size_t backlog_count;
+
+    epoch_t current;            // current epoch
+    epoch_t *ref_epoch;         // by ref id
+
+    unsigned long retires;
+    unsigned long failures;
+    unsigned long polls;
+    unsigned long peak_pending;
+    double pending_area;        // pending * nanoseconds
+    uint64_t last_time;
+
+    bench_hist_t gp;            // grace period, nanoseconds
+} sim_t;
+
+static inline int32_t xcmp(epoch_t a, epoch_t b) { return (int32_t) (a - b); }
+
+static int load_trace(const char *path, trace_t *trace)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+
+    if (fread(&trace->header, sizeof(smrtrace_header_t), 1, file) != 1
+        || trace->header.magic != SMRTRACE_MAGIC
+        || trace->header.version != SMRTRACE_VERSION)
+    {
+        fprintf(stderr, "%s: not a trace file\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    uint64_t capacity = trace->header.capacity;
+    uint64_t count = trace->header.count;
+    smrtrace_rec_t *ring = malloc(capacity * sizeof(smrtrace_rec_t));
+    if (fread(ring, sizeof(smrtrace_rec_t), capacity, file) != capacity)
+    {
+        fprintf(stderr, "%s: truncated trace file\n", path);
+        fclose(file);
+        free(ring);
+        return -1;
+    }
+    fclose(file);
+
+    // oldest record first, keep retires and ref samples
+    uint64_t start = count > capacity ? count - capacity : 0;
+    trace->events = malloc((count - start) * sizeof(event_t));
+    trace->count = 0;
+    trace->max_ref = 0;
+    for (uint64_t ndx = start; ndx < count; ndx++)
+    {
+        smrtrace_rec_t *rec = &ring[ndx % capacity];
+        if (rec->type != SMRTRACE_RETIRE && rec->type != SMRTRACE_REF)
+            continue;
+        event_t *event = &trace->events[trace->count++];
+        event->time = rec->time;
+        event->type = rec->type;
+        event->a = rec->a;
+        event->b = rec->b;
+        if (rec->type == SMRTRACE_REF && rec->a > trace->max_ref)
+            trace->max_ref = rec->a;
+    }
+
+    free(ring);
+    return 0;
+}
+
+static unsigned long pending(sim_t *sim)
+{
+    return sim->count + sim->backlog_count;
+}
+
+static void advance(sim_t *sim, uint64_t time)
+{
+    sim->pending_area += (double) pending(sim) * (time - sim->last_time);
+    sim->last_time = time;
+}
+
+static bool enqueue(sim_t *sim, pending_t *entry)
+{
+    if (sim->count == sim->queue_size)
+        return false;
+    sim->queue[(sim->head + sim->count) % sim->queue_size] = *entry;
+    sim->count++;
+    return true;
+}
+
+static void poll(sim_t *sim, trace_t *trace, uint64_t time)
+{
+    advance(sim, time);
+    sim->polls++;
+
+    epoch_t oldest = sim->current;
+    for (unsigned int id = 0; id <= trace->max_ref; id++)
+    {
+        epoch_t epoch = sim->ref_epoch[id];
+        if (epoch != 0 && xcmp(epoch, oldest) < 0)
+            oldest = epoch;
+    }
+
+    while (sim->count > 0 && xcmp(sim->queue[sim->head].expiry, oldest) < 0)
+    {
+        bench_hist_record(&sim->gp, time - sim->queue[sim->head].time);
+        sim->head = (sim->head + 1) % sim->queue_size;
+        sim->count--;
+    }
+
+    while (sim->backlog_count > 0 && enqueue(sim, &sim->backlog[sim->backlog_head]))
+    {
+        sim->backlog_head++;
+        sim->backlog_count--;
+    }
+}
+
+static void simulate(trace_t *trace, sim_t *sim)
+{
+    sim->queue = malloc(sim->queue_size * sizeof(pending_t));
+    sim->backlog = malloc(trace->count * sizeof(pending_t));
+    sim->ref_epoch = calloc(trace->max_ref + 1, sizeof(epoch_t));
+
+    uint64_t next_poll = sim->polltime;
+    for (size_t ndx = 0; ndx < trace->count; ndx++)
+    {
+        event_t *event = &trace->events[ndx];
+
+        for (; next_poll <= event->time; next_poll += sim->polltime)
+            poll(sim, trace, next_poll);
+
+        if (event->type == SMRTRACE_REF)
+        {
+            sim->ref_epoch[event->a] = event->b;
+            continue;
+        }
+
+        advance(sim, event->time);
+        pending_t entry = { event->time, event->a };
+        sim->current = event->a + 2;
+        sim->retires++;
+        if (sim->backlog_count > 0 || !enqueue(sim, &entry))
+        {
+            sim->failures++;
+            sim->backlog[sim->backlog_head + sim->backlog_count++] = entry;
+        }
+        if (pending(sim) > sim->peak_pending)
+            sim->peak_pending = pending(sim);
+
+        if (sim->policy == SIGNAL || (sim->policy == HALF && sim->count * 2 >= sim->queue_size))
+            poll(sim, trace, event->time);
+    }
+
+    // readers done, drain
+    memset(sim->ref_epoch, 0, (trace->max_ref + 1) * sizeof(epoch_t));
+    while (pending(sim) > 0)
+    {
+        poll(sim, trace, next_poll);
+        next_poll += sim->polltime;
+    }
+
+    free(sim->queue);
+    free(sim->backlog);
+    free(sim->ref_epoch);
+}
+
+static void report(FILE *out, trace_t *trace, unsigned int queue_size, unsigned int polltime, policy_t policy)
+{
+    sim_t *sim = calloc(1, sizeof(sim_t));
+    sim->queue_size = queue_size;
+    sim->polltime = (polltime > 0 ? polltime : 1) * 1000000ull;
+    sim->policy = policy;
+
+    simulate(trace, sim);
+
+    fprintf(out, "%u,%u,%s,%lu,%lu,%lu,%lu,%.1f,%.1f,%.1f,%.1f\n",
+        queue_size, polltime, policy_names[policy],
+        sim->retires, sim->failures, sim->polls, sim->peak_pending,
+        sim->last_time > 0 ? sim->pending_area / sim->last_time : 0.0,
+        bench_hist_percentile(&sim->gp, 50.0) * 1e-3,
+        bench_hist_percentile(&sim->gp, 99.0) * 1e-3,
+        sim->gp.max * 1e-3);
+
+    free(sim);
+}
+
+/*
+* synthetic workload for record
+*/
+typedef struct {
+    smrproxy_t *proxy;
+    atomic_bool stop;
+    void *pdata;
+    uint64_t seed;
+} workload_t;
+
+static uint64_t next_random(uint64_t *seed)
+{
+    uint64_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *seed = x;
+    return x;
+}
+
+static void spin(uint64_t nanos)
+{
+    uint64_t deadline = bench_nanos() + nanos;
+    while (bench_nanos() < deadline)
+        ;
+}
+
+static int record_reader(void *arg)
+{
+    workload_t *work = arg;
+    smrproxy_ref_t *ref = smrproxy_ref_create(work->proxy);
+    uint64_t seed = (uintptr_t) ref | 1;
+    while (!atomic_load(&work->stop))
+    {
+        smrproxy_ref_acquire(ref);
+        atomic_load_explicit(&work->pdata, memory_order_acquire);
+        spin(next_random(&seed) % 2000000);        // up to 2 msec
+        smrproxy_ref_release(ref);
+        spin(next_random(&seed) % 500000);
+    }
+    smrproxy_ref_destroy(ref);
+    return 0;
+}
+
+static int record(const char *path, unsigned int millis)
+{
+    workload_t *work = calloc(1, sizeof(workload_t));
+    work->proxy = smrproxy_create(NULL);
+    work->pdata = malloc(64);
+    work->seed = 0x9e3779b97f4a7c15ull;
+
+    if (smrproxy_trace_start(work->proxy, path, 1 << 20) != 0)
+    {
+        fprintf(stderr, "%s: can't start trace\n", path);
+        return 1;
+    }
+
+    thrd_t tids[2];
+    for (int ndx = 0; ndx < 2; ndx++)
+        thrd_create(&tids[ndx], &record_reader, work);
+
+    uint64_t end = bench_nanos() + millis * 1000000ull;
+    while (bench_nanos() < end)
+    {
+        void *data = atomic_exchange(&work->pdata, malloc(64));
+        while (smrproxy_retire(work->proxy, data, &free) == 0)
+            thrd_yield();
+        spin(next_random(&work->seed) % 100000);   // up to 100 usec
+    }
+
+    atomic_store(&work->stop, true);
+    for (int ndx = 0; ndx < 2; ndx++)
+        thrd_join(tids[ndx], NULL);
+
+    smrproxy_trace_stop(work->proxy);
+    smrproxy_destroy(work->proxy);
+    free(work->pdata);
+    free(work);
+    return 0;
+}
+
+static const unsigned int queue_sizes[] = { 100, 1000, 10000 };
+static const unsigned int polltimes[] = { 1, 10, 50 };
+#define COUNT(a) (sizeof(a) / sizeof(a[0]))
+
+int main(int argc, char **argv)
+{
+    if (argc > 2 && strcmp(argv[1], "record") == 0)
+        return record(argv[2], argc > 3 ? atoi(argv[3]) : 1000);
+
+    if (argc != 2 && argc != 5)
+    {
+        fprintf(stderr, "usage: replay record <trace file> [millis]\n"
+                        "       replay <trace file> [queue_size polltime signal|timer|half]\n");
+        return 1;
+    }
+
+    trace_t trace;
+    if (load_trace(argv[1], &trace) != 0)
+        return 1;
+
+    printf("# traced queue_size=%u polltime=%u records=%lu\n",
+        trace.header.queue_size, trace.header.polltime, (unsigned long) trace.header.count);
+    printf("queue_size,polltime,policy,retires,retire_failures,polls,peak_pending,avg_pending,"
+        "gp_p50_us,gp_p99_us,gp_max_us\n");
+
+    if (argc == 5)
+    {
+        int policy = 0;
+        while (policy < POLICIES && strcmp(argv[4], policy_names[policy]) != 0)
+            policy++;
+        if (policy == POLICIES)
+        {
+            fprintf(stderr, "unknown policy %s\n", argv[4]);
+            return 1;
+        }
+        report(stdout, &trace, atoi(argv[2]), atoi(argv[3]), policy);
+    }
+    else
+    {
+        for (unsigned int q = 0; q < COUNT(queue_sizes); q++)
+        for (unsigned int p = 0; p < COUNT(polltimes); p++)
+        for (int policy = 0; policy < POLICIES; policy++)
+            report(stdout, &trace, queue_sizes[q], polltimes[p], policy);
+    }
+
+    free(trace.events);
+    return 0;
+}
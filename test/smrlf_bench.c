@@ -0,0 +1,422 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include <string.h>
+
+#include <smrproxy.h>
+#include <smrlf.h>
+
+#include "bench.h"
+
+/**
+ * Lock-free queue and stack scaling benchmark.
+ *
+ * Compares smrmsq, smrmsq with batched dequeues, smrstack, a mutex
+ * protected queue and a Michael-Scott queue using counter tagged indices
+ * into a fixed node pool, the usual ABA workaround without safe memory
+ * reclamation, as producers and consumers scale.
+ *
+ * Producers stop adding while more than DEPTH values are queued so the
+ * container size stays bounded.
+ *
+ * usage: smrlf_bench [millis per run [max threads]]
+ *
+ * Output is csv, dequeued values per second in millions.
+*/
+
+#define DEPTH 4096
+#define BATCH 16
+#define POOL (1 << 16)
+
+typedef enum { MSQ, MSQ_BATCH, STACK, MUTEX, TAGGED } impl_t;
+static const char *impl_names[] = { "smrmsq", "smrmsq_batch", "smrstack", "mutex", "tagged" };
+#define IMPLS 5
+
+/*
+* mutex queue
+*/
+typedef struct mnode_t {
+    struct mnode_t *next;
+    void *value;
+} mnode_t;
+
+typedef struct {
+    mtx_t mutex;
+    mnode_t *head;
+    mnode_t *tail;
+} mqueue_t;
+
+static mqueue_t * mqueue_create()
+{
+    mqueue_t *queue = calloc(1, sizeof(mqueue_t));
+    mtx_init(&queue->mutex, mtx_plain);
+    return queue;
+}
+
+static void mqueue_destroy(mqueue_t *queue)
+{
+    while (queue->head != NULL)
+    {
+        mnode_t *node = queue->head;
+        queue->head = node->next;
+        free(node);
+    }
+    mtx_destroy(&queue->mutex);
+    free(queue);
+}
+
+static bool mqueue_enqueue(mqueue_t *queue, void *value)
+{
+    mnode_t *node = malloc(sizeof(mnode_t));
+    node->next = NULL;
+    node->value = value;
+    mtx_lock(&queue->mutex);
+    if (queue->tail == NULL)
+        queue->head = node;
+    else
+        queue->tail->next = node;
+    queue->tail = node;
+    mtx_unlock(&queue->mutex);
+    return true;
+}
+
+static bool mqueue_dequeue(mqueue_t *queue, void **pvalue)
+{
+    mtx_lock(&queue->mutex);
+    mnode_t *node = queue->head;
+    if (node != NULL)
+    {
+        queue->head = node->next;
+        if (queue->head == NULL)
+            queue->tail = NULL;
+    }
+    mtx_unlock(&queue->mutex);
+    if (node == NULL)
+        return false;
+    *pvalue = node->value;
+    free(node);
+    return true;
+}
+
+/*
+* tagged index queue, 32 bit tag and 32 bit index, nodes are never freed
+* so reading a recycled node is safe and the tag catches ABA
+*/
+#define NIL 0xffffffffu
+
+typedef struct {
+    _Atomic uint64_t next;
+    _Atomic(void *) value;
+} tnode_t;
+
+typedef struct {
+    _Alignas(128) _Atomic uint64_t head;
+    _Alignas(128) _Atomic uint64_t tail;
+    _Alignas(128) _Atomic uint64_t free;
+    tnode_t *nodes;
+} tqueue_t;
+
+static inline uint32_t tindex(uint64_t x) { return (uint32_t) x; }
+static inline uint64_t tnext(uint64_t x, uint32_t index) { return (((x >> 32) + 1) << 32) | index; }
+
+static void tfree_push(tqueue_t *queue, uint32_t index)
+{
+    tnode_t *node = &queue->nodes[index];
+    uint64_t top = atomic_load(&queue->free);
+    do {
+        atomic_store(&node->next, tnext(atomic_load(&node->next), tindex(top)));
+    } while (!atomic_compare_exchange_weak(&queue->free, &top, tnext(top, index)));
+}
+
+static uint32_t tfree_pop(tqueue_t *queue)
+{
+    uint64_t top = atomic_load(&queue->free);
+    for (;;)
+    {
+        if (tindex(top) == NIL)
+            return NIL;
+        uint64_t next = atomic_load(&queue->nodes[tindex(top)].next);
+        if (atomic_compare_exchange_weak(&queue->free, &top, tnext(top, tindex(next))))
+            return tindex(top);
+    }
+}
+
+static tqueue_t * tqueue_create()
+{
+    tqueue_t *queue = aligned_alloc(128, sizeof(tqueue_t));
+    memset(queue, 0, sizeof(tqueue_t));
+    queue->nodes = calloc(POOL, sizeof(tnode_t));
+    atomic_init(&queue->free, NIL);
+    for (uint32_t index = 1; index < POOL; index++)
+        tfree_push(queue, index);
+    atomic_init(&queue->nodes[0].next, NIL);  // dummy
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    return queue;
+}
+
+static void tqueue_destroy(tqueue_t *queue)
+{
+    free(queue->nodes);
+    free(queue);
+}
+
+static bool tqueue_enqueue(tqueue_t *queue, void *value)
+{
+    uint32_t index = tfree_pop(queue);
+    if (index == NIL)
+        return false;
+    tnode_t *node = &queue->nodes[index];
+    atomic_store(&node->value, value);
+    atomic_store(&node->next, tnext(atomic_load(&node->next), NIL));
+
+    for (;;)
+    {
+        uint64_t tail = atomic_load(&queue->tail);
+        uint64_t next = atomic_load(&queue->nodes[tindex(tail)].next);
+        if (tail != atomic_load(&queue->tail))
+            continue;
+        if (tindex(next) == NIL)
+        {
+            if (atomic_compare_exchange_strong(&queue->nodes[tindex(tail)].next, &next, tnext(next, index)))
+            {
+                atomic_compare_exchange_strong(&queue->tail, &tail, tnext(tail, index));
+                return true;
+            }
+        }
+        else
+            atomic_compare_exchange_strong(&queue->tail, &tail, tnext(tail, tindex(next)));
+    }
+}
+
+static bool tqueue_dequeue(tqueue_t *queue, void **pvalue)
+{
+    for (;;)
+    {
+        uint64_t head = atomic_load(&queue->head);
+        uint64_t tail = atomic_load(&queue->tail);
+        uint64_t next = atomic_load(&queue->nodes[tindex(head)].next);
+        if (head != atomic_load(&queue->head))
+            continue;
+        if (tindex(head) == tindex(tail))
+        {
+            if (tindex(next) == NIL)
+                return false;
+            atomic_compare_exchange_strong(&queue->tail, &tail, tnext(tail, tindex(next)));
+        }
+        else if (tindex(next) != NIL)       // NIL if head recycled since read
+        {
+            void *value = atomic_load(&queue->nodes[tindex(next)].value);
+            if (atomic_compare_exchange_strong(&queue->head, &head, tnext(head, tindex(next))))
+            {
+                tfree_push(queue, tindex(head));
+                *pvalue = value;
+                return true;
+            }
+        }
+    }
+}
+
+/*
+* benchmark
+*/
+typedef struct {
+    impl_t impl;
+    smrproxy_t *proxy;
+    smrmsq_t *msq;
+    smrstack_t *stack;
+    mqueue_t *mqueue;
+    tqueue_t *tqueue;
+
+    atomic_long depth;
+    atomic_int ready;
+    atomic_bool start;
+    atomic_bool stop;
+} env_t;
+
+typedef struct {
+    _Alignas(128) env_t *env;
+    unsigned long count;
+} worker_t;
+
+static bool do_add(env_t *env, smrproxy_ref_t *ref, void *value)
+{
+    bool rc;
+    switch (env->impl) {
+        case MSQ:
+        case MSQ_BATCH:
+            smrproxy_ref_acquire(ref);
+            rc = smrmsq_enqueue(env->msq, value);
+            smrproxy_ref_release(ref);
+            return rc;
+        case STACK:
+            return smrstack_push(env->stack, value);
+        case MUTEX:
+            return mqueue_enqueue(env->mqueue, value);
+        case TAGGED:
+            return tqueue_enqueue(env->tqueue, value);
+    }
+    return false;
+}
+
+static unsigned int do_remove(env_t *env, smrproxy_ref_t *ref, void **values)
+{
+    unsigned int n = 0;
+    switch (env->impl) {
+        case MSQ:
+            smrproxy_ref_acquire(ref);
+            n = smrmsq_dequeue(env->msq, values);
+            smrproxy_ref_release(ref);
+            break;
+        case MSQ_BATCH:
+            smrproxy_ref_acquire(ref);
+            n = smrmsq_dequeue_batch(env->msq, values, BATCH);
+            smrproxy_ref_release(ref);
+            break;
+        case STACK:
+            smrproxy_ref_acquire(ref);
+            n = smrstack_pop(env->stack, values);
+            smrproxy_ref_release(ref);
+            break;
+        case MUTEX:
+            n = mqueue_dequeue(env->mqueue, values);
+            break;
+        case TAGGED:
+            n = tqueue_dequeue(env->tqueue, values);
+            break;
+    }
+    return n;
+}
+
+static void wait_start(env_t *env)
+{
+    atomic_fetch_add(&env->ready, 1);
+    while (!atomic_load(&env->start))
+        thrd_yield();
+}
+
+static int producer(void *arg)
+{
+    worker_t *worker = arg;
+    env_t *env = worker->env;
+    smrproxy_ref_t *ref = smrproxy_ref_create(env->proxy);
+    uintptr_t value = 1;
+
+    wait_start(env);
+    while (!atomic_load_explicit(&env->stop, memory_order_relaxed))
+    {
+        if (atomic_load_explicit(&env->depth, memory_order_relaxed) > DEPTH
+            || !do_add(env, ref, (void *) value))
+        {
+            thrd_yield();
+            continue;
+        }
+        atomic_fetch_add_explicit(&env->depth, 1, memory_order_relaxed);
+        value++;
+        worker->count++;
+    }
+
+    smrproxy_ref_destroy(ref);
+    return 0;
+}
+
+static int consumer(void *arg)
+{
+    worker_t *worker = arg;
+    env_t *env = worker->env;
+    smrproxy_ref_t *ref = smrproxy_ref_create(env->proxy);
+    void *values[BATCH];
+
+    wait_start(env);
+    while (!atomic_load_explicit(&env->stop, memory_order_relaxed))
+    {
+        unsigned int n = do_remove(env, ref, values);
+        if (n == 0)
+        {
+            thrd_yield();
+            continue;
+        }
+        atomic_fetch_sub_explicit(&env->depth, n, memory_order_relaxed);
+        worker->count += n;
+    }
+
+    smrproxy_ref_destroy(ref);
+    return 0;
+}
+
+static void run(impl_t impl, unsigned int producers, unsigned int consumers, unsigned int millis)
+{
+    env_t *env = calloc(1, sizeof(env_t));
+    env->impl = impl;
+    env->proxy = smrproxy_create(NULL);
+    switch (impl) {
+        case MSQ:
+        case MSQ_BATCH: env->msq = smrmsq_create(env->proxy, NULL); break;
+        case STACK: env->stack = smrstack_create(env->proxy, NULL); break;
+        case MUTEX: env->mqueue = mqueue_create(); break;
+        case TAGGED: env->tqueue = tqueue_create(); break;
+    }
+
+    unsigned int count = producers + consumers;
+    worker_t *workers = aligned_alloc(128, count * sizeof(worker_t));
+    thrd_t *tids = calloc(count, sizeof(thrd_t));
+    for (unsigned int ndx = 0; ndx < count; ndx++)
+    {
+        workers[ndx].env = env;
+        workers[ndx].count = 0;
+        thrd_create(&tids[ndx], ndx < producers ? &producer : &consumer, &workers[ndx]);
+    }
+
+    while (atomic_load(&env->ready) < (int) count)
+        thrd_yield();
+    uint64_t t0 = bench_nanos();
+    atomic_store(&env->start, true);
+    thrd_sleep(&(struct timespec) { .tv_sec = millis / 1000, .tv_nsec = (millis % 1000) * 1000000l }, NULL);
+    atomic_store(&env->stop, true);
+    for (unsigned int ndx = 0; ndx < count; ndx++)
+        thrd_join(tids[ndx], NULL);
+    uint64_t elapsed = bench_nanos() - t0;
+
+    unsigned long added = 0;
+    unsigned long removed = 0;
+    for (unsigned int ndx = 0; ndx < count; ndx++)
+    {
+        if (ndx < producers)
+            added += workers[ndx].count;
+        else
+            removed += workers[ndx].count;
+    }
+
+    printf("%s,%u,%u,%lu,%lu,%.3f\n", impl_names[impl], producers, consumers,
+        added, removed, elapsed > 0 ? (removed * 1e3) / elapsed : 0.0);
+    fflush(stdout);
+
+    switch (impl) {
+        case MSQ:
+        case MSQ_BATCH: smrmsq_destroy(env->msq); break;
+        case STACK: smrstack_destroy(env->stack); break;
+        case MUTEX: mqueue_destroy(env->mqueue); break;
+        case TAGGED: tqueue_destroy(env->tqueue); break;
+    }
+    smrproxy_destroy(env->proxy);
+    free(workers);
+    free(tids);
+    free(env);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int millis = argc > 1 ? atoi(argv[1]) : 500;
+    unsigned int max_threads = argc > 2 ? atoi(argv[2]) : 4;
+
+    printf("impl,producers,consumers,enqueued,dequeued,mops\n");
+    for (unsigned int producers = 1; producers <= max_threads; producers *= 2)
+    for (unsigned int consumers = 1; consumers <= max_threads; consumers *= 2)
+    for (int impl = 0; impl < IMPLS; impl++)
+        run(impl, producers, consumers, millis);
+
+    return 0;
+}
+
+/*-*/
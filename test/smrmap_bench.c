@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <smrproxy.h>
+#include <smrmap.h>
+
+/**
+ * Range scan throughput of smrmap as reader threads scale,
+ * with one writer continuously replacing values.
+ *
+ * usage: smrmap_bench [keys [scan length [millis per run]]]
+ *
+ * Output is csv, one line per reader thread count.
+*/
+
+typedef struct {
+    smrproxy_t *proxy;
+    smrmap_t *map;
+    unsigned int nkeys;
+    unsigned int scanlen;
+
+    atomic_bool stop;
+    atomic_ulong scans;
+    atomic_ulong keys;
+    atomic_ulong updates;
+} env_t;
+
+typedef struct {
+    env_t *env;
+    uint64_t seed;
+} thread_t;
+
+static volatile uint64_t sink;     // keeps scan results live
+
+static uint64_t next_random(uint64_t *seed)
+{
+    uint64_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *seed = x;
+    return x;
+}
+
+static bool visit(uint64_t key, void *value, void *ctx)
+{
+    uint64_t *sum = ctx;
+    *sum += *(uint64_t *) value;
+    return true;
+}
+
+static int reader(void *arg)
+{
+    thread_t *thread = arg;
+    env_t *env = thread->env;
+    smrproxy_ref_t *ref = smrproxy_ref_create(env->proxy);
+
+    unsigned long scans = 0;
+    unsigned long keys = 0;
+    uint64_t sum = 0;
+
+    while (!atomic_load_explicit(&env->stop, memory_order_relaxed))
+    {
+        uint64_t lo = next_random(&thread->seed) % env->nkeys;
+
+        smrproxy_ref_acquire(ref);
+        keys += smrmap_scan(env->map, ref, lo, lo + env->scanlen - 1, &visit, &sum);
+        smrproxy_ref_release(ref);
+        scans++;
+    }
+
+    atomic_fetch_add(&env->scans, scans);
+    atomic_fetch_add(&env->keys, keys);
+    sink = sum;
+    smrproxy_ref_destroy(ref);
+    return 0;
+}
+
+static int writer(void *arg)
+{
+    thread_t *thread = arg;
+    env_t *env = thread->env;
+    unsigned long updates = 0;
+
+    while (!atomic_load_explicit(&env->stop, memory_order_relaxed))
+    {
+        uint64_t key = next_random(&thread->seed) % env->nkeys;
+        uint64_t *value = malloc(sizeof(uint64_t));
+        *value = key;
+        smrmap_put(env->map, key, value);
+        updates++;
+    }
+
+    atomic_fetch_add(&env->updates, updates);
+    return 0;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int nkeys = argc > 1 ? atoi(argv[1]) : 100000;
+    unsigned int scanlen = argc > 2 ? atoi(argv[2]) : 100;
+    unsigned int millis = argc > 3 ? atoi(argv[3]) : 1000;
+    int ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    smrproxy_config_t *config = smrproxy_default_config();
+    config->queue_size = 1000;
+
+    env_t env;
+    memset(&env, 0, sizeof(env));
+    env.proxy = smrproxy_create(config);
+    env.map = smrmap_create(env.proxy, &free, 0);
+    env.nkeys = nkeys;
+    env.scanlen = scanlen;
+
+    for (uint64_t key = 0; key < nkeys; key++)
+    {
+        uint64_t *value = malloc(sizeof(uint64_t));
+        *value = key;
+        smrmap_put(env.map, key, value);
+    }
+
+    fprintf(stdout, "readers,keys,scanlen,seconds,scans_per_sec,keys_per_sec,updates_per_sec\n");
+
+    for (int nreaders = 1; ; nreaders = nreaders * 2 < ncpu ? nreaders * 2 : ncpu)
+    {
+        thrd_t tids[nreaders + 1];
+        thread_t threads[nreaders + 1];
+
+        atomic_store(&env.stop, false);
+        atomic_store(&env.scans, 0);
+        atomic_store(&env.keys, 0);
+        atomic_store(&env.updates, 0);
+
+        double start = now();
+        for (int ndx = 0; ndx <= nreaders; ndx++)
+        {
+            threads[ndx].env = &env;
+            threads[ndx].seed = 0x9e3779b97f4a7c15ull * (ndx + 1);
+            thrd_create(&tids[ndx], ndx == 0 ? &writer : &reader, &threads[ndx]);
+        }
+
+        struct timespec ts = { millis / 1000, (millis % 1000) * 1000000 };
+        thrd_sleep(&ts, NULL);
+        atomic_store(&env.stop, true);
+
+        for (int ndx = 0; ndx <= nreaders; ndx++)
+            thrd_join(tids[ndx], NULL);
+        double elapsed = now() - start;
+
+        fprintf(stdout, "%d,%u,%u,%.3f,%.0f,%.0f,%.0f\n",
+            nreaders, nkeys, scanlen, elapsed,
+            env.scans / elapsed, env.keys / elapsed, env.updates / elapsed);
+
+        if (nreaders == ncpu)
+            break;
+    }
+
+    smrmap_destroy(env.map);
+    smrproxy_destroy(env.proxy);
+    free(config);
+    return 0;
+}
@@ -0,0 +1,367 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <threads.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include <smrproxy.h>
+
+#include "bench.h"
+
+/**
+ * Read side throughput and latency as reader threads scale, for smrproxy,
+ * smrproxy with implicit thread local refs, and mutex, rwlock, seqlock and
+ * std::atomic<std::shared_ptr> baselines, at several read/write ratios.
+ * L1D read misses per op are reported where hardware counters are available.
+ *
+ * usage: smrproxy_bench [millis per run [output file]]
+ *
+ * Output is csv.  Built as smrproxy_bench, with SMRPROXY_MB defined as
+ * smrproxy_bench_mb and with SMRPROXY_CLOCK defined as smrproxy_bench_clock.
+*/
+
+#if defined(SMRPROXY_CLOCK)
+#define MODE "clock"
+#elif defined(SMRPROXY_MB)
+#define MODE "mb"
+#else
+#define MODE "default"
+#endif
+
+#define SAMPLE 8        // measure latency of every 8th op
+
+typedef struct env_t env_t;
+
+typedef struct {
+    env_t *env;
+    uint64_t seed;
+
+    smrproxy_ref_t *ref;
+
+    unsigned long reads;
+    unsigned long writes;
+    unsigned long errors;       // inconsistent reads
+    int64_t misses;             // L1D read misses or -1 if not available
+    bench_hist_t hist;
+} thread_t;
+
+typedef struct {
+    const char *name;
+    uint64_t (*read)(env_t *env, thread_t *thread);
+    void (*write)(env_t *env, thread_t *thread, uint64_t value);
+} method_t;
+
+typedef struct env_t {
+    const method_t *method;
+    unsigned int write_permille;
+    atomic_int ready;           // threads done with setup
+    atomic_bool go;             // start barrier, set once all threads are ready
+    atomic_bool stop;
+
+    smrproxy_t *proxy;
+    bench_data_t *pdata;
+
+    pthread_mutex_t mutex;
+    pthread_rwlock_t rwlock;
+    bench_data_t data;
+
+    atomic_uint seq;
+    atomic_flag seqlock;
+
+    bench_sp_t *sp;
+} env_t;
+
+static uint64_t next_random(uint64_t *seed)
+{
+    uint64_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *seed = x;
+    return x;
+}
+
+/*
+* smrproxy
+*/
+static uint64_t smrproxy_read(env_t *env, thread_t *thread)
+{
+    smrproxy_ref_acquire(thread->ref);
+    bench_data_t *data = atomic_load_explicit(&env->pdata, memory_order_acquire);
+    uint64_t sum = bench_data_sum(data);
+    smrproxy_ref_release(thread->ref);
+    return sum;
+}
+
+static void smrproxy_write(env_t *env, thread_t *thread, uint64_t value)
+{
+    bench_data_t *data = malloc(sizeof(bench_data_t));
+    bench_data_set(data, value);
+    data = atomic_exchange_explicit(&env->pdata, data, memory_order_acq_rel);
+    while (smrproxy_retire(env->proxy, data, &free) == 0)
+        thrd_yield();       // retire queue full
+}
+
+/*
+* smrproxy, implicit thread local ref
+*/
+static uint64_t smrproxy_tls_read(env_t *env, thread_t *thread)
+{
+    smrproxy_read_lock(env->proxy);
+    bench_data_t *data = atomic_load_explicit(&env->pdata, memory_order_acquire);
+    uint64_t sum = bench_data_sum(data);
+    smrproxy_read_unlock(env->proxy);
+    return sum;
+}
+
+/*
+* pthread mutex
+*/
+static uint64_t mutex_read(env_t *env, thread_t *thread)
+{
+    pthread_mutex_lock(&env->mutex);
+    uint64_t sum = bench_data_sum(&env->data);
+    pthread_mutex_unlock(&env->mutex);
+    return sum;
+}
+
+static void mutex_write(env_t *env, thread_t *thread, uint64_t value)
+{
+    pthread_mutex_lock(&env->mutex);
+    bench_data_set(&env->data, value);
+    pthread_mutex_unlock(&env->mutex);
+}
+
+/*
+* pthread rwlock
+*/
+static uint64_t rwlock_read(env_t *env, thread_t *thread)
+{
+    pthread_rwlock_rdlock(&env->rwlock);
+    uint64_t sum = bench_data_sum(&env->data);
+    pthread_rwlock_unlock(&env->rwlock);
+    return sum;
+}
+
+static void rwlock_write(env_t *env, thread_t *thread, uint64_t value)
+{
+    pthread_rwlock_wrlock(&env->rwlock);
+    bench_data_set(&env->data, value);
+    pthread_rwlock_unlock(&env->rwlock);
+}
+
+/*
+* seqlock
+*/
+static uint64_t seqlock_read(env_t *env, thread_t *thread)
+{
+    uint64_t sum;
+    unsigned int seq;
+    do {
+        while ((seq = atomic_load_explicit(&env->seq, memory_order_acquire)) & 1)
+            ;
+        sum = 0;
+        for (int ndx = 0; ndx < BENCH_VALUES; ndx++)
+            sum += atomic_load_explicit(&env->data.value[ndx], memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+    } while (atomic_load_explicit(&env->seq, memory_order_relaxed) != seq);
+    return sum;
+}
+
+static void seqlock_write(env_t *env, thread_t *thread, uint64_t value)
+{
+    while (atomic_flag_test_and_set_explicit(&env->seqlock, memory_order_acquire))
+        thrd_yield();
+
+    unsigned int seq = atomic_load_explicit(&env->seq, memory_order_relaxed);
+    atomic_store_explicit(&env->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (int ndx = 0; ndx < BENCH_VALUES; ndx++)
+        atomic_store_explicit(&env->data.value[ndx], value, memory_order_relaxed);
+    atomic_store_explicit(&env->seq, seq + 2, memory_order_release);
+
+    atomic_flag_clear_explicit(&env->seqlock, memory_order_release);
+}
+
+/*
+* std::atomic<std::shared_ptr>
+*/
+static uint64_t sp_read(env_t *env, thread_t *thread)
+{
+    return bench_sp_read(env->sp);
+}
+
+static void sp_write(env_t *env, thread_t *thread, uint64_t value)
+{
+    bench_sp_write(env->sp, value);
+}
+
+static const method_t methods[] = {
+    { "smrproxy", &smrproxy_read, &smrproxy_write },
+    { "smrproxy_tls", &smrproxy_tls_read, &smrproxy_write },
+    { "mutex", &mutex_read, &mutex_write },
+    { "rwlock", &rwlock_read, &rwlock_write },
+    { "seqlock", &seqlock_read, &seqlock_write },
+    { "shared_ptr", &sp_read, &sp_write },
+};
+#define METHODS (sizeof(methods) / sizeof(method_t))
+
+static const unsigned int write_permille[] = { 0, 1, 10, 100 };
+#define RATIOS (sizeof(write_permille) / sizeof(unsigned int))
+
+static int run(void *arg)
+{
+    thread_t *thread = arg;
+    env_t *env = thread->env;
+    const method_t *method = env->method;
+
+    thread->ref = smrproxy_ref_create(env->proxy);
+    int fd = bench_misses_open();
+
+    atomic_fetch_add(&env->ready, 1);
+    while (!atomic_load_explicit(&env->go, memory_order_acquire))
+        thrd_yield();
+
+    int64_t misses = bench_misses_read(fd);
+
+    for (unsigned long op = 0; !atomic_load_explicit(&env->stop, memory_order_relaxed); op++)
+    {
+        uint64_t r = next_random(&thread->seed);
+        bool write = (r % 1000) < env->write_permille;
+        bool sample = (op % SAMPLE) == 0;
+
+        uint64_t t0 = sample ? bench_ticks() : 0;
+        if (write)
+        {
+            (*method->write)(env, thread, r >> 16);
+            thread->writes++;
+        }
+        else
+        {
+            uint64_t sum = (*method->read)(env, thread);
+            if (sum % BENCH_VALUES != 0)
+                thread->errors++;
+            thread->reads++;
+        }
+        if (sample && !write)
+            bench_hist_record(&thread->hist, bench_ticks() - t0);
+    }
+
+    thread->misses = fd != -1 ? bench_misses_read(fd) - misses : -1;
+    bench_misses_close(fd);
+
+    smrproxy_ref_destroy(thread->ref);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int millis = argc > 1 ? atoi(argv[1]) : 1000;
+    FILE *out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (out == NULL)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+
+    int ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    double ticks_per_ns = bench_calibrate();
+
+    smrproxy_config_t *config = smrproxy_default_config();
+    config->queue_size = 10000;
+
+    env_t *env = malloc(sizeof(env_t));
+    memset(env, 0, sizeof(env_t));
+    env->proxy = smrproxy_create(config);
+    env->pdata = malloc(sizeof(bench_data_t));
+    bench_data_set(env->pdata, 0);
+    pthread_mutex_init(&env->mutex, NULL);
+    pthread_rwlock_init(&env->rwlock, NULL);
+    atomic_flag_clear(&env->seqlock);
+    env->sp = bench_sp_create();
+
+    fprintf(out, "mode,method,threads,write_pct,seconds,reads,writes,reads_per_sec,p50_ns,p99_ns,p999_ns,max_ns,errors,"
+        "l1d_misses_per_op\n");
+
+    for (unsigned int m = 0; m < METHODS; m++)
+    for (unsigned int w = 0; w < RATIOS; w++)
+    for (int nthreads = 1; ; nthreads = nthreads * 2 < ncpu ? nthreads * 2 : ncpu)
+    {
+        thrd_t tids[nthreads];
+        thread_t *threads = calloc(nthreads, sizeof(thread_t));
+
+        env->method = &methods[m];
+        env->write_permille = write_permille[w];
+        atomic_store(&env->ready, 0);
+        atomic_store(&env->go, false);
+        atomic_store(&env->stop, false);
+
+        for (int ndx = 0; ndx < nthreads; ndx++)
+        {
+            threads[ndx].env = env;
+            threads[ndx].seed = 0x9e3779b97f4a7c15ull * (ndx + 1);
+            thrd_create(&tids[ndx], &run, &threads[ndx]);
+        }
+
+        /*
+        * time from when every thread has its ref and counters set up
+        */
+        while (atomic_load(&env->ready) < nthreads)
+            thrd_yield();
+        uint64_t start = bench_nanos();
+        atomic_store_explicit(&env->go, true, memory_order_release);
+
+        struct timespec ts = { millis / 1000, (millis % 1000) * 1000000 };
+        thrd_sleep(&ts, NULL);
+        atomic_store(&env->stop, true);
+
+        for (int ndx = 0; ndx < nthreads; ndx++)
+            thrd_join(tids[ndx], NULL);
+        double elapsed = (bench_nanos() - start) * 1e-9;
+
+        bench_hist_t *hist = calloc(1, sizeof(bench_hist_t));
+        unsigned long reads = 0, writes = 0, errors = 0;
+        int64_t misses = 0;
+        for (int ndx = 0; ndx < nthreads; ndx++)
+        {
+            reads += threads[ndx].reads;
+            writes += threads[ndx].writes;
+            errors += threads[ndx].errors;
+            misses = misses != -1 && threads[ndx].misses != -1 ? misses + threads[ndx].misses : -1;
+            bench_hist_merge(hist, &threads[ndx].hist);
+        }
+
+        unsigned long ops = reads + writes;
+        fprintf(out, "%s,%s,%d,%.1f,%.3f,%lu,%lu,%.0f,%.1f,%.1f,%.1f,%.1f,%lu,%.3f\n",
+            MODE, methods[m].name, nthreads, write_permille[w] / 10.0, elapsed,
+            reads, writes, reads / elapsed,
+            bench_hist_percentile(hist, 50.0) / ticks_per_ns,
+            bench_hist_percentile(hist, 99.0) / ticks_per_ns,
+            bench_hist_percentile(hist, 99.9) / ticks_per_ns,
+            hist->max / ticks_per_ns,
+            errors,
+            misses != -1 && ops != 0 ? (double) misses / ops : -1.0);       // -1 if not available
+        fflush(out);
+
+        free(hist);
+        free(threads);
+
+        if (nthreads == ncpu)
+            break;
+    }
+
+    bench_sp_destroy(env->sp);
+    pthread_rwlock_destroy(&env->rwlock);
+    pthread_mutex_destroy(&env->mutex);
+    smrproxy_destroy(env->proxy);
+    free(env->pdata);
+    free(env);
+    free(config);
+
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}